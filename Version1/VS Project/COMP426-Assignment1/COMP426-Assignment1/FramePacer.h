@@ -0,0 +1,197 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+// Shared by Versions 1 to 4 (the others add this folder to their include paths).
+// GLUT has to be included before this header, its path differs between the versions
+#include <chrono>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+inline double ProcessCpuSeconds()
+{
+	/**
+	@Desc : Returns the CPU time used so far by all threads of the process
+	*/
+
+#ifdef _WIN32
+	FILETIME _creation, _exit, _kernel, _user;
+	GetProcessTimes(GetCurrentProcess(), &_creation, &_exit, &_kernel, &_user);
+	ULARGE_INTEGER _kernelTime, _userTime;
+	_kernelTime.LowPart = _kernel.dwLowDateTime;
+	_kernelTime.HighPart = _kernel.dwHighDateTime;
+	_userTime.LowPart = _user.dwLowDateTime;
+	_userTime.HighPart = _user.dwHighDateTime;
+	// FILETIME counts 100 ns intervals
+	return (_kernelTime.QuadPart + _userTime.QuadPart) * 1e-7;
+#else
+	struct rusage _usage;
+	getrusage(RUSAGE_SELF, &_usage);
+	return (_usage.ru_utime.tv_sec + _usage.ru_stime.tv_sec) + (_usage.ru_utime.tv_usec + _usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+inline bool FrameIntervalFromRate(const std::string &rate, int &interval)
+{
+	/**
+	@Desc : Converts a --refresh= rate to the time between frames, at least 1 ms so a high rate does not become a busy loop
+	@param1 : refresh rate in Hz
+	@param2 : receives the time between frames in ms
+	@return : false if the rate is not a whole number above 0
+	*/
+
+	if (rate.empty() || rate.find_first_not_of("0123456789") != std::string::npos)
+		return false;
+	char *_end;
+	long _rate = strtol(rate.c_str(), &_end, 10);
+	if (*_end != '\0' || _rate <= 0)
+		return false;
+	interval = _rate > 1000 ? 1 : (int)(1000 / _rate);
+	return true;
+}
+
+inline int MonitorRefreshRate()
+{
+	/**
+	@Desc : Returns the refresh rate of the main monitor in Hz (60 if it cannot be queried, the rate can then be set with --refresh=)
+	*/
+
+#ifdef _WIN32
+	HDC _dc = GetDC(NULL);
+	int _rate = GetDeviceCaps(_dc, VREFRESH);
+	ReleaseDC(NULL, _dc);
+	// 0 and 1 mean the hardware default rate
+	if (_rate > 1)
+		return _rate;
+#endif
+	return 60;
+}
+
+class FramePacer
+{
+	/**
+	@Desc : Only draws a frame when a new generation or an input event arrives, at most once per monitor refresh.
+	Also measures generations per second, frames per second and CPU usage, printed every few seconds so runs with
+	and without the pacer can be compared. A program has one pacer, since the GLUT timer cannot carry a pointer
+	*/
+
+public:
+	FramePacer()
+		: enabled(true), redrawPending(false), timerArmed(false), interval(16), frames(0), generations(0), cpuStart(0.0)
+	{
+		Instance() = this;
+	}
+
+	// Whether frames are drawn on change (otherwise the idle function redraws continuously)
+	bool Enabled() const { return enabled; }
+	// Only changes the mode, the caller switches the idle function
+	void SetEnabled(bool on) { enabled = on; }
+	// Time between frames in ms
+	int Interval() const { return interval; }
+	void SetInterval(int milliseconds) { interval = milliseconds; }
+
+	void RequestRedisplay()
+	{
+		/**
+		@Desc : Asks for a new frame because a generation finished or an input event arrived.
+		Requests that come in less than one monitor refresh after the last frame are merged into one frame
+		*/
+
+		// Without the pacer the idle function redraws continuously
+		if (!enabled)
+			return;
+
+		redrawPending = true;
+		if (timerArmed)
+			return;
+		int _elapsed = (int)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - lastFrame).count();
+		if (_elapsed >= interval) {
+			glutPostRedisplay();
+		}
+		else {
+			timerArmed = true;
+			glutTimerFunc(interval - _elapsed, FrameTimer, 0);
+		}
+	}
+
+	// Records that a frame was drawn (called at the start of Display)
+	void FrameDrawn()
+	{
+		redrawPending = false;
+		lastFrame = std::chrono::steady_clock::now();
+		frames++;
+	}
+
+	// Counts finished generations for the next report
+	void GenerationsDone(int count) { generations += count; }
+	// Generations finished since the last report
+	int Generations() const { return generations; }
+
+	// Whether the measurement interval is over and Report should be called
+	bool ReportDue() const
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - statStart).count() * 1000.0 >= statsInterval;
+	}
+
+	void Report(const char *details)
+	{
+		/**
+		@Desc : Prints generations per second, frames per second and CPU usage, then starts a new measurement interval
+		@param1 : text added to the end of the line, with the measurements that only one version has
+		*/
+
+		double _wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - statStart).count();
+		// CPU usage is relative to one core, so a busy redraw loop shows up as (at least) 100%
+		double _cpu = ProcessCpuSeconds() - cpuStart;
+		printf("[pacer %s] %.1f generations/s, %.1f frames/s, %.1f%% CPU%s\n", enabled ? "on" : "off",
+			generations / _wall, frames / _wall, 100.0 * _cpu / _wall, details);
+		ResetStats();
+	}
+
+	// Starts a new throughput and CPU usage measurement interval
+	void ResetStats()
+	{
+		frames = 0;
+		generations = 0;
+		statStart = std::chrono::steady_clock::now();
+		cpuStart = ProcessCpuSeconds();
+	}
+
+private:
+	FramePacer(const FramePacer &);
+	FramePacer &operator=(const FramePacer &);
+
+	static FramePacer *&Instance()
+	{
+		static FramePacer *_instance = NULL;
+		return _instance;
+	}
+
+	// Draws the frame that was held back to stay within the monitor refresh rate
+	static void FrameTimer(int value)
+	{
+		FramePacer *_pacer = Instance();
+		_pacer->timerArmed = false;
+		if (_pacer->redrawPending)
+			glutPostRedisplay();
+	}
+
+	static const int statsInterval = 5000;
+
+	bool enabled;
+	bool redrawPending;
+	bool timerArmed;
+	int interval;
+	std::chrono::steady_clock::time_point lastFrame;
+	int frames;
+	int generations;
+	std::chrono::steady_clock::time_point statStart;
+	double cpuStart;
+};
+
+#endif
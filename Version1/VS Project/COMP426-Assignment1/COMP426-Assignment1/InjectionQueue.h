@@ -0,0 +1,110 @@
+#ifndef INJECTION_QUEUE_H
+#define INJECTION_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+struct InjectionEvent
+{
+	/**
+	@Desc : Medicine injection requested by the user (mouse click or drag)
+	*/
+
+	// Cell that was clicked
+	int x;
+	int y;
+	// Milliseconds since the simulation started when the event was created
+	long long timestamp;
+	// Generation at which the event was applied (filled in when it is drained)
+	int generation;
+};
+
+template <typename T, std::size_t Capacity>
+class InjectionQueue
+{
+	/**
+	@Desc : Bounded lock-free multi-producer / single-consumer queue
+	(each slot carries a sequence number telling producers and the consumer whose turn it is)
+	*/
+
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+	struct Slot
+	{
+		std::atomic<std::size_t> sequence;
+		T data;
+	};
+
+	Slot slots[Capacity];
+	// Next position a producer will write to
+	std::atomic<std::size_t> head;
+	// Next position the consumer will read from
+	std::atomic<std::size_t> tail;
+
+	InjectionQueue(const InjectionQueue &);
+	InjectionQueue &operator=(const InjectionQueue &);
+
+public:
+	InjectionQueue()
+	{
+		for (std::size_t i = 0; i < Capacity; i++)
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+		head.store(0, std::memory_order_relaxed);
+		tail.store(0, std::memory_order_relaxed);
+	}
+
+	bool Push(const T &item)
+	{
+		/**
+		@Desc : Adds an item to the queue (safe to call from any thread)
+		@param1 : item to add
+		@return : false if the queue is full and the item was dropped
+		*/
+
+		std::size_t _pos = head.load(std::memory_order_relaxed);
+		Slot *_slot;
+		for (;;) {
+			_slot = &slots[_pos & (Capacity - 1)];
+			std::size_t _seq = _slot->sequence.load(std::memory_order_acquire);
+			std::ptrdiff_t _diff = (std::ptrdiff_t)_seq - (std::ptrdiff_t)_pos;
+			if (_diff == 0) {
+				// Slot is free, try to claim it
+				if (head.compare_exchange_weak(_pos, _pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (_diff < 0) {
+				// Consumer has not caught up yet
+				return false;
+			}
+			else {
+				// Another producer claimed this slot, retry with the new head
+				_pos = head.load(std::memory_order_relaxed);
+			}
+		}
+		_slot->data = item;
+		_slot->sequence.store(_pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool Pop(T &item)
+	{
+		/**
+		@Desc : Removes the oldest item from the queue (only one thread may call this)
+		@param1 : receives the removed item
+		@return : false if the queue is empty
+		*/
+
+		std::size_t _pos = tail.load(std::memory_order_relaxed);
+		Slot &_slot = slots[_pos & (Capacity - 1)];
+		std::size_t _seq = _slot.sequence.load(std::memory_order_acquire);
+		if ((std::ptrdiff_t)_seq - (std::ptrdiff_t)(_pos + 1) < 0)
+			return false;
+		item = _slot.data;
+		// Hand the slot back to the producers for the next lap around the ring
+		_slot.sequence.store(_pos + Capacity, std::memory_order_release);
+		tail.store(_pos + 1, std::memory_order_relaxed);
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,259 @@
+#include "Palette.h"
+#include "PaletteSimd.h"
+#include <string.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+unsigned int PackRGBA(float r, float g, float b)
+{
+	/**
+	@Desc : Packs a colour into a 32-bit RGBA pixel
+	@param1 : red component (0 to 1)
+	@param2 : green component (0 to 1)
+	@param3 : blue component (0 to 1)
+	*/
+
+	unsigned int _r = (unsigned int)(r * 255.0f + 0.5f);
+	unsigned int _g = (unsigned int)(g * 255.0f + 0.5f);
+	unsigned int _b = (unsigned int)(b * 255.0f + 0.5f);
+	return _r | (_g << 8) | (_b << 16) | (0xFFu << 24);
+}
+
+static bool CpuSupports(const char *instructionSet)
+{
+	/**
+	@Desc : Tells whether the CPU (and for AVX2 the operating system, which must save the wider registers) runs an instruction set
+	@param1 : ssse3 or avx2
+	*/
+
+	bool _avx2 = strcmp(instructionSet, "avx2") == 0;
+#if defined(_MSC_VER) && defined(PALETTE_X86)
+	int _info[4];
+	__cpuid(_info, 0);
+	int _maxLeaf = _info[0];
+	__cpuid(_info, 1);
+	if (!_avx2)
+		return (_info[2] & (1 << 9)) != 0;
+	bool _osxsave = (_info[2] & (1 << 27)) != 0;
+	if (_maxLeaf < 7 || !_osxsave)
+		return false;
+	unsigned long long _xcr0 = _xgetbv(0);
+	__cpuidex(_info, 7, 0);
+	return (_info[1] & (1 << 5)) && (_xcr0 & 0x6) == 0x6;
+#elif defined(__GNUC__) && defined(PALETTE_X86)
+	__builtin_cpu_init();
+	return _avx2 ? __builtin_cpu_supports("avx2") != 0 : __builtin_cpu_supports("ssse3") != 0;
+#else
+	return false;
+#endif
+}
+
+static void ConvertRowsPortable(const int *cells, int gridHeight, int startX, int startY, int width,
+	unsigned int *image, const unsigned int palette[4], int firstRow, int lastRow)
+{
+	/**
+	@Desc : Converts rows firstRow to lastRow - 1 one cell at a time, for CPUs without SSSE3
+	*/
+
+	ConvertRowsScalar(cells, gridHeight, startX, startY, width, image, palette, firstRow, lastRow, 0);
+}
+
+struct ConvertRowsVariant
+{
+	ConvertRowsFunction function;
+	const char *name;
+};
+
+static ConvertRowsVariant SelectConvertRows()
+{
+	/**
+	@Desc : Picks the widest variant that both this build and the CPU can run
+	*/
+
+	ConvertRowsVariant _variant = { ConvertRowsPortable, "scalar" };
+	if (PaletteAVX2() && CpuSupports("avx2")) {
+		_variant.function = PaletteAVX2();
+		_variant.name = "AVX2";
+	}
+	else if (PaletteSSSE3() && CpuSupports("ssse3")) {
+		_variant.function = PaletteSSSE3();
+		_variant.name = "SSSE3";
+	}
+	return _variant;
+}
+
+// Chosen once at startup, before any conversion
+static const ConvertRowsVariant g_convertRows = SelectConvertRows();
+
+class ConvertWorkers
+{
+	/**
+	@Desc : Threads that stay alive between frames and help convert the bands of rows of each frame,
+	so drawing does not create and join threads every time
+	*/
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	// Workers wait for a new conversion on start, the caller waits for the last band on done
+	std::condition_variable start;
+	std::condition_variable done;
+	// Conversion in progress, incremented for every conversion so workers notice a new one
+	int conversion;
+	bool stopping;
+	const int *cells;
+	int gridHeight;
+	int startX;
+	int startY;
+	int width;
+	int height;
+	unsigned int *image;
+	const unsigned int *palette;
+	int band;
+	// First row of the next band to hand out
+	std::atomic<int> nextRow;
+	// Workers that have not finished the current conversion yet
+	int busyWorkers;
+
+	void Worker()
+	{
+		/**
+		@Desc : Thread of the pool, helps with every conversion until the program ends
+		*/
+
+		int _seen = 0;
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> _lock(mutex);
+				start.wait(_lock, [&] { return stopping || conversion != _seen; });
+				if (stopping)
+					return;
+				_seen = conversion;
+			}
+			ConvertBands();
+			{
+				std::lock_guard<std::mutex> _lock(mutex);
+				busyWorkers--;
+			}
+			done.notify_one();
+		}
+	}
+
+	void ConvertBands()
+	{
+		/**
+		@Desc : Converts bands of the current conversion until none are left
+		*/
+
+		for (int _first = nextRow.fetch_add(band); _first < height; _first = nextRow.fetch_add(band)) {
+			int _last = _first + band < height ? _first + band : height;
+			g_convertRows.function(cells, gridHeight, startX, startY, width, image, palette, _first, _last);
+		}
+	}
+
+public:
+	ConvertWorkers() : conversion(0), stopping(false), cells(0), gridHeight(0), startX(0), startY(0), width(0), height(0),
+		image(0), palette(0), band(1), nextRow(0), busyWorkers(0) { }
+
+	~ConvertWorkers()
+	{
+		{
+			std::lock_guard<std::mutex> _lock(mutex);
+			stopping = true;
+		}
+		start.notify_all();
+		for (size_t i = 0; i < workers.size(); i++)
+			workers[i].join();
+	}
+
+	void Convert(const int *cells, int gridHeight, int startX, int startY, int width, int height,
+		unsigned int *image, const unsigned int *palette, int band, int numThreads)
+	{
+		/**
+		@Desc : Converts the rows in bands, on the calling thread and numThreads - 1 workers
+		(the parameters are those of ConvertToRGBA, plus the number of rows of a band)
+		*/
+
+		// Start the workers the first time they are needed
+		while ((int)workers.size() < numThreads - 1)
+			workers.push_back(std::thread(&ConvertWorkers::Worker, this));
+
+		{
+			std::lock_guard<std::mutex> _lock(mutex);
+			this->cells = cells;
+			this->gridHeight = gridHeight;
+			this->startX = startX;
+			this->startY = startY;
+			this->width = width;
+			this->height = height;
+			this->image = image;
+			this->palette = palette;
+			this->band = band;
+			nextRow = 0;
+			busyWorkers = (int)workers.size();
+			conversion++;
+		}
+		start.notify_all();
+
+		// The calling thread converts bands as well
+		ConvertBands();
+		std::unique_lock<std::mutex> _lock(mutex);
+		done.wait(_lock, [&] { return busyWorkers == 0; });
+	}
+};
+
+// Shared by every call, the frames are drawn from one thread
+static ConvertWorkers g_convertWorkers;
+
+void ConvertToRGBA(const int *cells, int gridHeight, int startX, int startY, int width, int height,
+	unsigned int *image, const unsigned int palette[4], int numThreads)
+{
+	/**
+	@Desc : Expands cell states into a row-major RGBA image, splitting the rows between the calling thread and a pool of workers
+	@param1 : cell states, stored column by column
+	@param2 : number of cells in a column of the grid
+	@param3 : x position of the first cell to convert
+	@param4 : y position of the first cell to convert
+	@param5 : number of columns to convert (width of the image)
+	@param6 : number of rows to convert (height of the image)
+	@param7 : receives width * height pixels
+	@param8 : colour of each state
+	@param9 : number of threads to use
+	*/
+
+	if (numThreads < 1)
+		numThreads = 1;
+	// Each thread gets a band of rows that is a multiple of 8 so the SIMD tiles stay full
+	int _band = ((height + numThreads - 1) / numThreads + 7) & ~7;
+
+	// One band needs no other thread
+	if (numThreads == 1 || _band >= height)
+		g_convertRows.function(cells, gridHeight, startX, startY, width, image, palette, 0, height);
+	else
+		g_convertWorkers.Convert(cells, gridHeight, startX, startY, width, height, image, palette, _band, numThreads);
+}
+
+void ConvertToRGBAScalar(const int *cells, int gridHeight, int startX, int startY, int width, int height,
+	unsigned int *image, const unsigned int palette[4])
+{
+	/**
+	@Desc : Expands cell states into a row-major RGBA image one cell at a time
+	*/
+
+	ConvertRowsScalar(cells, gridHeight, startX, startY, width, image, palette, 0, height, 0);
+}
+
+const char *PaletteInstructionSet()
+{
+	/**
+	@Desc : Returns the instruction set ConvertToRGBA uses on this CPU (AVX2, SSSE3 or scalar)
+	*/
+
+	return g_convertRows.name;
+}
@@ -0,0 +1,20 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+// Packs a colour into a 32-bit RGBA pixel (red in the lowest byte, as OpenGL reads GL_RGBA / GL_UNSIGNED_BYTE)
+unsigned int PackRGBA(float r, float g, float b);
+
+// Expands cell states into a row-major RGBA image.
+// cells is stored column by column (cells[x * gridHeight + y]) and states must be 0 to 3;
+// the rectangle (startX, startY, width, height) of the grid is written to image[row * width + column]
+void ConvertToRGBA(const int *cells, int gridHeight, int startX, int startY, int width, int height,
+	unsigned int *image, const unsigned int palette[4], int numThreads);
+
+// Same conversion, one cell at a time on the calling thread (reference for the SIMD version)
+void ConvertToRGBAScalar(const int *cells, int gridHeight, int startX, int startY, int width, int height,
+	unsigned int *image, const unsigned int palette[4]);
+
+// Instruction set ConvertToRGBA picked for this CPU at startup: AVX2, SSSE3 or scalar
+const char *PaletteInstructionSet();
+
+#endif
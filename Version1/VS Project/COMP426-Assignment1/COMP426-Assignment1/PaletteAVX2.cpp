@@ -0,0 +1,63 @@
+// Compiled for AVX2 (GCC and Clang need the pragma, Visual Studio accepts the intrinsics as they are),
+// only called once CPUID reports AVX2
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC target("avx2")
+#elif defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#endif
+#include "PaletteSimd.h"
+
+#ifdef PALETTE_X86
+#include <immintrin.h>
+
+static void ConvertRowsAVX2(const int *cells, int gridHeight, int startX, int startY, int width,
+	unsigned int *image, const unsigned int palette[4], int firstRow, int lastRow)
+{
+	/**
+	@Desc : Converts rows firstRow to lastRow - 1 in tiles of 4 columns x 8 rows.
+	Each column of 8 states is looked up in one vpermd, then the tile is transposed into rows
+	*/
+
+	__m256i _palette = _mm256_setr_epi32(palette[0], palette[1], palette[2], palette[3], palette[0], palette[1], palette[2], palette[3]);
+	__m256i _mask = _mm256_set1_epi32(3);
+
+	int _row = firstRow;
+	for (; _row + 8 <= lastRow; _row += 8)
+	{
+		int _column = 0;
+		for (; _column + 4 <= width; _column += 4)
+		{
+			const int *_in = cells + (size_t)(startX + _column) * gridHeight + startY + _row;
+			__m256i _c0 = _mm256_permutevar8x32_epi32(_palette, _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(_in)), _mask));
+			__m256i _c1 = _mm256_permutevar8x32_epi32(_palette, _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(_in + gridHeight)), _mask));
+			__m256i _c2 = _mm256_permutevar8x32_epi32(_palette, _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(_in + 2 * gridHeight)), _mask));
+			__m256i _c3 = _mm256_permutevar8x32_epi32(_palette, _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(_in + 3 * gridHeight)), _mask));
+
+			unsigned int *_out = image + (size_t)_row * width + _column;
+			StoreTransposed(_mm256_castsi256_si128(_c0), _mm256_castsi256_si128(_c1),
+				_mm256_castsi256_si128(_c2), _mm256_castsi256_si128(_c3), _out, width);
+			StoreTransposed(_mm256_extracti128_si256(_c0, 1), _mm256_extracti128_si256(_c1, 1),
+				_mm256_extracti128_si256(_c2, 1), _mm256_extracti128_si256(_c3, 1), _out + 4 * width, width);
+		}
+		ConvertRowsScalar(cells, gridHeight, startX, startY, width, image, palette, _row, _row + 8, _column);
+	}
+	ConvertRowsScalar(cells, gridHeight, startX, startY, width, image, palette, _row, lastRow, 0);
+}
+
+ConvertRowsFunction PaletteAVX2()
+{
+	return ConvertRowsAVX2;
+}
+
+#else
+
+ConvertRowsFunction PaletteAVX2()
+{
+	return NULL;
+}
+
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
@@ -0,0 +1,71 @@
+// Compiled for SSSE3 (GCC and Clang need the pragma, Visual Studio accepts the intrinsics as they are),
+// only called once CPUID reports SSSE3
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC target("ssse3")
+#elif defined(__clang__)
+#pragma clang attribute push(__attribute__((target("ssse3"))), apply_to = function)
+#endif
+#include "PaletteSimd.h"
+
+#ifdef PALETTE_X86
+#include <tmmintrin.h>
+
+static inline __m128i LookUp(__m128i states, __m128i palette, __m128i spread, __m128i offsets)
+{
+	/**
+	@Desc : Looks up the colours of 4 states with one pshufb.
+	The palette is exactly 16 bytes, so state s selects bytes 4s to 4s + 3
+	*/
+
+	__m128i _index = _mm_shuffle_epi8(_mm_slli_epi32(_mm_and_si128(states, _mm_set1_epi32(3)), 2), spread);
+	return _mm_shuffle_epi8(palette, _mm_add_epi8(_index, offsets));
+}
+
+static void ConvertRowsSSSE3(const int *cells, int gridHeight, int startX, int startY, int width,
+	unsigned int *image, const unsigned int palette[4], int firstRow, int lastRow)
+{
+	/**
+	@Desc : Converts rows firstRow to lastRow - 1 in tiles of 4 columns x 4 rows.
+	Each column of 4 states is looked up in one pshufb, then the tile is transposed into rows
+	*/
+
+	__m128i _palette = _mm_setr_epi32(palette[0], palette[1], palette[2], palette[3]);
+	// Copies the low byte of each state (already multiplied by 4) to all 4 bytes of its pixel
+	__m128i _spread = _mm_setr_epi8(0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12);
+	__m128i _offsets = _mm_setr_epi8(0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3);
+
+	int _row = firstRow;
+	for (; _row + 4 <= lastRow; _row += 4)
+	{
+		int _column = 0;
+		for (; _column + 4 <= width; _column += 4)
+		{
+			const int *_in = cells + (size_t)(startX + _column) * gridHeight + startY + _row;
+			__m128i _c0 = LookUp(_mm_loadu_si128((const __m128i *)(_in)), _palette, _spread, _offsets);
+			__m128i _c1 = LookUp(_mm_loadu_si128((const __m128i *)(_in + gridHeight)), _palette, _spread, _offsets);
+			__m128i _c2 = LookUp(_mm_loadu_si128((const __m128i *)(_in + 2 * gridHeight)), _palette, _spread, _offsets);
+			__m128i _c3 = LookUp(_mm_loadu_si128((const __m128i *)(_in + 3 * gridHeight)), _palette, _spread, _offsets);
+			StoreTransposed(_c0, _c1, _c2, _c3, image + (size_t)_row * width + _column, width);
+		}
+		ConvertRowsScalar(cells, gridHeight, startX, startY, width, image, palette, _row, _row + 4, _column);
+	}
+	ConvertRowsScalar(cells, gridHeight, startX, startY, width, image, palette, _row, lastRow, 0);
+}
+
+ConvertRowsFunction PaletteSSSE3()
+{
+	return ConvertRowsSSSE3;
+}
+
+#else
+
+ConvertRowsFunction PaletteSSSE3()
+{
+	return NULL;
+}
+
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
@@ -0,0 +1,51 @@
+#ifndef PALETTE_SIMD_H
+#define PALETTE_SIMD_H
+
+#include "Palette.h"
+#include <stddef.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define PALETTE_X86
+#include <emmintrin.h>
+#endif
+
+// Converts rows firstRow to lastRow - 1 of the rectangle (the other parameters are those of ConvertToRGBA)
+typedef void (*ConvertRowsFunction)(const int *cells, int gridHeight, int startX, int startY, int width,
+	unsigned int *image, const unsigned int palette[4], int firstRow, int lastRow);
+
+// Each instruction set variant lives in its own translation unit, compiled for that instruction set.
+// They return NULL if the compiler cannot build the variant
+ConvertRowsFunction PaletteSSSE3();
+ConvertRowsFunction PaletteAVX2();
+
+// The helpers below are static so each translation unit keeps its own copy, compiled for its instruction set
+// (an inline function shared between them could be linked in from the AVX2 unit and run on any CPU)
+
+// Converts the columns from firstColumn onwards of rows firstRow to lastRow - 1, one cell at a time
+static inline void ConvertRowsScalar(const int *cells, int gridHeight, int startX, int startY, int width,
+	unsigned int *image, const unsigned int palette[4], int firstRow, int lastRow, int firstColumn)
+{
+	for (int row = firstRow; row < lastRow; row++)
+	{
+		unsigned int *_out = image + (size_t)row * width;
+		for (int column = firstColumn; column < width; column++)
+			_out[column] = palette[cells[(size_t)(startX + column) * gridHeight + startY + row] & 3];
+	}
+}
+
+#ifdef PALETTE_X86
+// Transposes 4 columns of 4 pixels into 4 rows and stores them (the cells are stored by column, the image by row)
+static inline void StoreTransposed(__m128i c0, __m128i c1, __m128i c2, __m128i c3, unsigned int *out, int width)
+{
+	__m128i _t0 = _mm_unpacklo_epi32(c0, c1);
+	__m128i _t1 = _mm_unpacklo_epi32(c2, c3);
+	__m128i _t2 = _mm_unpackhi_epi32(c0, c1);
+	__m128i _t3 = _mm_unpackhi_epi32(c2, c3);
+	_mm_storeu_si128((__m128i *)(out), _mm_unpacklo_epi64(_t0, _t1));
+	_mm_storeu_si128((__m128i *)(out + width), _mm_unpackhi_epi64(_t0, _t1));
+	_mm_storeu_si128((__m128i *)(out + 2 * width), _mm_unpacklo_epi64(_t2, _t3));
+	_mm_storeu_si128((__m128i *)(out + 3 * width), _mm_unpackhi_epi64(_t2, _t3));
+}
+#endif
+
+#endif
@@ -0,0 +1,86 @@
+#include "StatePyramid.h"
+
+StatePyramid::StatePyramid(int width, int height)
+	: width(width), height(height), topLevel(0)
+{
+	// Keep halving until a single tile covers the whole area
+	while ((1 << topLevel) < width || (1 << topLevel) < height)
+		topLevel++;
+
+	tilesX.resize(topLevel + 1);
+	tilesY.resize(topLevel + 1);
+	counts.resize(topLevel + 1, nullptr);
+	for (int k = 0; k <= topLevel; k++) {
+		tilesX[k] = (width + (1 << k) - 1) >> k;
+		tilesY[k] = (height + (1 << k) - 1) >> k;
+		if (k > 0)
+			counts[k] = new std::atomic<int>[tilesX[k] * tilesY[k] * NumStates];
+	}
+	Clear();
+}
+
+StatePyramid::~StatePyramid()
+{
+	for (int k = 0; k <= topLevel; k++)
+		delete[] counts[k];
+}
+
+void StatePyramid::Clear()
+{
+	/**
+	@Desc : Resets every count to zero
+	*/
+
+	for (int k = 1; k <= topLevel; k++) {
+		int _size = tilesX[k] * tilesY[k] * NumStates;
+		for (int i = 0; i < _size; i++)
+			counts[k][i].store(0, std::memory_order_relaxed);
+	}
+}
+
+void StatePyramid::Add(int x, int y, int state)
+{
+	/**
+	@Desc : Adds a cell to the counts of every tile containing it
+	@param1 : x position of cell
+	@param2 : y position of cell
+	@param3 : state of cell
+	*/
+
+	for (int k = 1; k <= topLevel; k++) {
+		int _tile = (y >> k) * tilesX[k] + (x >> k);
+		counts[k][_tile * NumStates + state].fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void StatePyramid::Change(int x, int y, int from, int to)
+{
+	/**
+	@Desc : Moves a cell from one state to another in every tile containing it
+	@param1 : x position of cell
+	@param2 : y position of cell
+	@param3 : previous state of cell
+	@param4 : new state of cell
+	*/
+
+	if (from == to)
+		return;
+	for (int k = 1; k <= topLevel; k++) {
+		int _tile = (y >> k) * tilesX[k] + (x >> k);
+		counts[k][_tile * NumStates + from].fetch_sub(1, std::memory_order_relaxed);
+		counts[k][_tile * NumStates + to].fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+int StatePyramid::Count(int level, int tileX, int tileY, int state) const
+{
+	/**
+	@Desc : Returns the number of cells of a tile that are in a given state
+	@param1 : level of tile (1 to TopLevel())
+	@param2 : x index of tile
+	@param3 : y index of tile
+	@param4 : state to count
+	*/
+
+	return counts[level][(tileY * tilesX[level] + tileX) * NumStates + state].load(std::memory_order_relaxed);
+}
@@ -0,0 +1,51 @@
+#ifndef STATE_PYRAMID_H
+#define STATE_PYRAMID_H
+
+#include <atomic>
+#include <vector>
+
+class StatePyramid
+{
+	/**
+	@Desc : Number of cells in each state for every tile of a power-of-two tile hierarchy.
+	Level k holds tiles of 2^k x 2^k cells (level 0, the cells themselves, is not stored) and
+	the top level is a single tile covering the whole area. Counts are kept up to date as cells
+	change, so zoomed-out views and totals never have to read the cells
+	*/
+
+public:
+	static const int NumStates = 3;
+
+	StatePyramid(int width, int height);
+	~StatePyramid();
+
+	// Resets every count to zero
+	void Clear();
+	// Adds a cell to the counts (used when initializing the area)
+	void Add(int x, int y, int state);
+	// Moves a cell from one state to another (safe to call from several threads)
+	void Change(int x, int y, int from, int to);
+
+	// Index of the top level (tiles at that level cover the whole area)
+	int TopLevel() const { return topLevel; }
+	int TilesX(int level) const { return tilesX[level]; }
+	int TilesY(int level) const { return tilesY[level]; }
+	// Number of cells of a tile that are in the given state
+	int Count(int level, int tileX, int tileY, int state) const;
+	// Number of cells of the whole area that are in the given state
+	int Total(int state) const { return Count(topLevel, 0, 0, state); }
+
+private:
+	StatePyramid(const StatePyramid &);
+	StatePyramid &operator=(const StatePyramid &);
+
+	int width;
+	int height;
+	int topLevel;
+	std::vector<int> tilesX;
+	std::vector<int> tilesY;
+	// One array per level of tilesX * tilesY * NumStates counters
+	std::vector<std::atomic<int> *> counts;
+};
+
+#endif
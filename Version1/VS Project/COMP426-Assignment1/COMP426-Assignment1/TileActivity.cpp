@@ -0,0 +1,65 @@
+#include "TileActivity.h"
+
+TileActivity::TileActivity(int width, int height, int tileSize)
+	: tileSize(tileSize), tilesX((width + tileSize - 1) / tileSize), tilesY((height + tileSize - 1) / tileSize)
+{
+	changed = new std::atomic<bool>[tilesX * tilesY];
+	active.resize(tilesX * tilesY, 0);
+	MarkAll();
+}
+
+TileActivity::~TileActivity()
+{
+	delete[] changed;
+}
+
+void TileActivity::MarkAll()
+{
+	/**
+	@Desc : Marks every tile as changed, so every tile is updated in the next generation
+	*/
+
+	for (int i = 0; i < tilesX * tilesY; i++)
+		changed[i].store(true, std::memory_order_relaxed);
+}
+
+int TileActivity::BeginGeneration()
+{
+	/**
+	@Desc : Activates every tile that changed or borders a tile that changed since the last call, then clears
+	the changed flags (called between generations, while no thread is updating cells)
+	@return : number of active tiles
+	*/
+
+	int _numActive = 0;
+	for (int ty = 0; ty < tilesY; ty++) {
+		for (int tx = 0; tx < tilesX; tx++) {
+			bool _active = ChangedAround(tx, ty);
+			active[ty * tilesX + tx] = _active;
+			if (_active)
+				_numActive++;
+		}
+	}
+
+	for (int i = 0; i < tilesX * tilesY; i++)
+		changed[i].store(false, std::memory_order_relaxed);
+	return _numActive;
+}
+
+bool TileActivity::ChangedAround(int tileX, int tileY) const
+{
+	/**
+	@Desc : Checks the changed flags of a tile and of the 8 tiles around it
+	@param1 : x position of the tile
+	@param2 : y position of the tile
+	@return : whether any of them changed since the last BeginGeneration
+	*/
+
+	for (int ny = (tileY > 0 ? tileY - 1 : 0); ny <= (tileY < tilesY - 1 ? tileY + 1 : tileY); ny++) {
+		for (int nx = (tileX > 0 ? tileX - 1 : 0); nx <= (tileX < tilesX - 1 ? tileX + 1 : tileX); nx++) {
+			if (changed[ny * tilesX + nx].load(std::memory_order_relaxed))
+				return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,54 @@
+#ifndef TILE_ACTIVITY_H
+#define TILE_ACTIVITY_H
+
+#include <atomic>
+#include <vector>
+
+class TileActivity
+{
+	/**
+	@Desc : Which square tiles of the area changed. A cell only changes when a cell around it changed since
+	it was last updated. Cells are updated in place, so that change can come from the last generation or
+	from a cell updated earlier in the current one: a tile is only worth updating if it or one of the
+	8 tiles around it changed in either; every other tile is stable and is skipped
+	*/
+
+public:
+	TileActivity(int width, int height, int tileSize);
+	~TileActivity();
+
+	// Marks every tile as changed (used when the whole area was initialized)
+	void MarkAll();
+	// Marks the tile containing a cell as changed (safe to call from several threads)
+	void Changed(int x, int y)
+	{
+		std::atomic<bool> &_flag = changed[(y / tileSize) * tilesX + x / tileSize];
+		// Most changes land on a tile that is already marked, so avoid writing to a shared cache line
+		if (!_flag.load(std::memory_order_relaxed))
+			_flag.store(true, std::memory_order_relaxed);
+	}
+	// Works out the active tiles from the changes since the last call, then starts collecting the
+	// changes of the next generation. Returns the number of active tiles
+	int BeginGeneration();
+
+	int TileSize() const { return tileSize; }
+	int TilesX() const { return tilesX; }
+	int TilesY() const { return tilesY; }
+	// Whether a tile has to be updated because of the changes of the last generation
+	bool IsActive(int tileX, int tileY) const { return active[tileY * tilesX + tileX] != 0; }
+	// Whether a cell of the tile or of one of the 8 tiles around it changed since the last BeginGeneration
+	bool ChangedAround(int tileX, int tileY) const;
+
+private:
+	TileActivity(const TileActivity &);
+	TileActivity &operator=(const TileActivity &);
+
+	int tileSize;
+	int tilesX;
+	int tilesY;
+	// One flag per tile, set when a cell of the tile changed
+	std::atomic<bool> *changed;
+	std::vector<unsigned char> active;
+};
+
+#endif
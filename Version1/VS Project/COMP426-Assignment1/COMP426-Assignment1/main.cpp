@@ -2,8 +2,20 @@
 #include <GL/gl.h>
 #include <GL/glut.h>
 #include <thread>
+#include <atomic>
 #include <time.h>
 #include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include <fstream>
+#include <math.h>
+#include "InjectionQueue.h"
+#include "StatePyramid.h"
+#include "TileActivity.h"
+#include "Palette.h"
+#include "FramePacer.h"
 
 // Define states for cells
 #define HEALTHY  0
@@ -13,16 +25,111 @@
 // 2D area of 1024 x 768 cells
 const int g_windowWidth = 1024;
 const int g_windowHeight = 768;
-int g_quad[g_windowWidth][g_windowHeight];
+// Cells are atomic because the heal cascade crosses quadrant borders, so two threads can change the same cell
+std::atomic<int> g_quad[g_windowWidth][g_windowHeight];
+static_assert(sizeof(std::atomic<int>) == sizeof(int), "The palette conversion reads the cells as plain ints");
 
 // Update every 1/30th second
 const int g_updateTime = 1.0 / 30.0 * 1000.0;
 
+// How generations are scheduled:
+// FIXED_RATE runs one generation every g_updateTime and catches up with several generations per callback when behind,
+// MAX_THROUGHPUT runs as many generations as fit between two frames,
+// STEP only advances one generation when the step key is pressed
+enum TickMode { FIXED_RATE, MAX_THROUGHPUT, STEP };
+const char *g_tickModeNames[] = { "Fixed rate", "Max throughput", "Step" };
+TickMode g_tickMode = FIXED_RATE;
+
+// Fixed rate never runs more than this many generations in one callback, and gives up on a backlog older than g_maxLag
+const int g_maxCatchUp = 4;
+const int g_maxLag = 1000;
+
+// Time at which the next fixed rate generation is due
+std::chrono::steady_clock::time_point g_nextTick;
+// How far the simulation is behind its schedule in milliseconds
+double g_tickLag = 0.0;
+// Scheduled callbacks from before the last mode change carry an old epoch and are ignored
+int g_tickEpoch = 0;
+
+// Generations per second, measured over roughly half a second
+double g_generationRate = 0.0;
+int g_rateGenerations = 0;
+std::chrono::steady_clock::time_point g_rateStart;
+
 // At least 25% of cells initialized as cancer cells
 const int g_initialCancer = g_windowWidth * g_windowHeight * 0.26;
 
 const int g_font = (int)GLUT_BITMAP_TIMES_ROMAN_24;
 
+// Frames are only drawn when a new generation or an input event arrives, at most once per monitor refresh.
+// The pacer also prints the throughput and CPU usage every few seconds
+FramePacer g_pacer;
+
+// Medicine injections waiting to be applied at the next generation boundary
+InjectionQueue<InjectionEvent, 4096> g_injections;
+
+// Number of generations computed so far
+int g_generation = 0;
+
+// Time at which the simulation started (injection timestamps are relative to it)
+std::chrono::steady_clock::time_point g_startTime;
+
+// Left mouse button is held down, so dragging injects medicine along the path
+bool g_mouseDown = false;
+int g_lastInjectX = -1;
+int g_lastInjectY = -1;
+
+// Seed used to place the initial cancer cells
+unsigned int g_seed = 0;
+
+// Applied injections are written here when recording (--record=<file>)
+std::ofstream g_recordFile;
+
+// Injections loaded from a previous recording (--replay=<file>), in generation order
+std::vector<InjectionEvent> g_replay;
+size_t g_replayNext = 0;
+
+// Cell counts per tile, used for the zoomed-out view and the on-screen totals
+StatePyramid g_pyramid(g_windowWidth, g_windowHeight);
+
+// Tiles of 32 x 32 cells that changed: tiles with no change around them are skipped by the update threads
+const int g_tileSize = 32;
+TileActivity g_activity(g_windowWidth, g_windowHeight, g_tileSize);
+bool g_skipStableTiles = true;
+// Active tiles summed over the generations of the current measurement interval
+long long g_statActiveTiles = 0;
+
+// Colour of each cell state: healthy cells are green, cancer cells are red, medicine cells are yellow
+const float g_stateColours[3][3] = { { 0, 0.5, 0 }, { 1, 0, 0 }, { 1, 1, 0 } };
+
+// Colour of each cell state packed as RGBA pixels, for the texture and image export
+unsigned int g_palette[4];
+
+// Visible cells converted to pixels, and the texture they are drawn with
+std::vector<unsigned int> g_image;
+GLuint g_texture = 0;
+
+// Number of threads used to convert cells to pixels
+int g_numThreads = 4;
+
+// Size of the window in pixels
+int g_viewWidth = g_windowWidth;
+int g_viewHeight = g_windowHeight;
+
+// Viewport: pixels per cell and the cell shown at the top left corner of the window
+float g_zoom = 1.0f;
+float g_panX = 0.0f;
+float g_panY = 0.0f;
+const float g_maxZoom = 64.0f;
+
+// Zoomed-out tiles are coloured by their majority state, or by a blend of the states (density)
+bool g_densityColours = false;
+
+// Right mouse button is held down, so dragging pans the view
+bool g_panning = false;
+int g_panLastX = 0;
+int g_panLastY = 0;
+
 void RenderBitmapString(float x, float y, void *font, const char *string)
 {
 	/**
@@ -40,55 +147,259 @@ void RenderBitmapString(float x, float y, void *font, const char *string)
 	}
 }
 
-void Display()
+void ResetFrameStats()
 {
 	/**
-	@Desc : Displays the cells and text in a window on screen
+	@Desc : Starts a new throughput and CPU usage measurement interval
 	*/
 
-	// Display the cells using OpenGL
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glLoadIdentity();
+	g_pacer.ResetStats();
+	g_statActiveTiles = 0;
+}
 
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	gluOrtho2D(0, g_windowWidth, g_windowHeight, 0);
+void ReportFrameStats()
+{
+	/**
+	@Desc : Prints the pacer measurements once per measurement interval, with the share of active tiles
+	*/
 
-	glClearColor(1, 1, 1,1);
-	glClear(GL_COLOR_BUFFER_BIT);
+	if (!g_pacer.ReportDue())
+		return;
+
+	// Share of the tiles that had to be updated, which is what a generation costs once the area settles
+	double _active = g_pacer.Generations() > 0 ? 100.0 * g_statActiveTiles / g_pacer.Generations() / (g_activity.TilesX() * g_activity.TilesY()) : 0.0;
+	char _details[32];
+	sprintf(_details, ", %.1f%% tiles active", g_skipStableTiles ? _active : 100.0);
+	g_pacer.Report(_details);
+	g_statActiveTiles = 0;
+}
+
+const int *QuadCells()
+{
+	/**
+	@Desc : Returns the cells as a plain int array, column by column, for the palette conversion
+	*/
+
+	return reinterpret_cast<const int *>(&g_quad[0][0]);
+}
+
+void SetCell(int x, int y, int state)
+{
+	/**
+	@Desc : Changes the state of a cell and keeps the tile counts up to date
+	@param1 : x position of cell
+	@param2 : y position of cell
+	@param3 : new state of cell
+	*/
+
+	// Only the thread whose compare-and-swap makes the change updates the counts,
+	// so a cell changed by two threads at once is not counted twice
+	int _old = g_quad[x][y].load(std::memory_order_relaxed);
+	while (_old != state && !g_quad[x][y].compare_exchange_weak(_old, state)) { }
+	if (_old != state) {
+		g_pyramid.Change(x, y, _old, state);
+		g_activity.Changed(x, y);
+	}
+}
+
+void ScreenToCell(int sx, int sy, int &x, int &y)
+{
+	/**
+	@Desc : Converts a window position to the cell under it
+	@param1 : x position in the window
+	@param2 : y position in the window
+	@param3 : receives the x position of the cell
+	@param4 : receives the y position of the cell
+	*/
+
+	x = (int)floor(g_panX + sx / g_zoom);
+	y = (int)floor(g_panY + sy / g_zoom);
+}
+
+void ZoomAt(float zoom, int sx, int sy)
+{
+	/**
+	@Desc : Changes the zoom while keeping the cell under a window position in place
+	@param1 : new number of pixels per cell
+	@param2 : x position in the window to zoom around
+	@param3 : y position in the window to zoom around
+	*/
+
+	// Zooming out stops once the whole area fits in one pixel
+	float _minZoom = 1.0f / (1 << g_pyramid.TopLevel());
+	if (zoom < _minZoom)
+		zoom = _minZoom;
+	if (zoom > g_maxZoom)
+		zoom = g_maxZoom;
+
+	float _cellX = g_panX + sx / g_zoom;
+	float _cellY = g_panY + sy / g_zoom;
+	g_zoom = zoom;
+	g_panX = _cellX - sx / g_zoom;
+	g_panY = _cellY - sy / g_zoom;
+	g_pacer.RequestRedisplay();
+}
+
+void ResetView()
+{
+	/**
+	@Desc : Zooms and pans so the whole cell area fits in the window
+	*/
+
+	float _zoomX = (float)g_viewWidth / g_windowWidth;
+	float _zoomY = (float)g_viewHeight / g_windowHeight;
+	g_zoom = _zoomX < _zoomY ? _zoomX : _zoomY;
+	g_panX = 0.0f;
+	g_panY = 0.0f;
+	g_pacer.RequestRedisplay();
+}
+
+int ViewLevel()
+{
+	/**
+	@Desc : Picks the pyramid level whose tiles are about one pixel wide at the current zoom
+	@return : 0 when individual cells are at least one pixel wide
+	*/
+
+	int _level = 0;
+	while (_level < g_pyramid.TopLevel() && (1 << _level) * g_zoom < 1.0f)
+		_level++;
+	return _level;
+}
+
+void DrawCells()
+{
+	/**
+	@Desc : Draws the visible cells as one texture (used when a cell covers at least one pixel)
+	*/
+
+	int _startX, _startY, _endX, _endY;
+	ScreenToCell(0, 0, _startX, _startY);
+	ScreenToCell(g_viewWidth, g_viewHeight, _endX, _endY);
+	if (_startX < 0) _startX = 0;
+	if (_startY < 0) _startY = 0;
+	if (_endX > g_windowWidth - 1) _endX = g_windowWidth - 1;
+	if (_endY > g_windowHeight - 1) _endY = g_windowHeight - 1;
+	if (_endX < _startX || _endY < _startY)
+		return;
+
+	// Convert only the visible cells to pixels
+	int _width = _endX - _startX + 1;
+	int _height = _endY - _startY + 1;
+	g_image.resize(_width * _height);
+	ConvertToRGBA(QuadCells(), g_windowHeight, _startX, _startY, _width, _height, &g_image[0], g_palette, g_numThreads);
+
+	glBindTexture(GL_TEXTURE_2D, g_texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, _width, _height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &g_image[0]);
+
+	float _left = (_startX - g_panX) * g_zoom;
+	float _top = (_startY - g_panY) * g_zoom;
+	float _right = _left + _width * g_zoom;
+	float _bottom = _top + _height * g_zoom;
+	glEnable(GL_TEXTURE_2D);
+	glColor3f(1, 1, 1);
 	glBegin(GL_QUADS);
-	int _healthyCount = 0;
-	int _cancerCount = 0;
-	int _medicineCount = 0;
-	for (int x = 0; x < g_windowWidth; x++)
+	glTexCoord2f(0, 0);
+	glVertex2f(_left, _top);
+	glTexCoord2f(1, 0);
+	glVertex2f(_right, _top);
+	glTexCoord2f(1, 1);
+	glVertex2f(_right, _bottom);
+	glTexCoord2f(0, 1);
+	glVertex2f(_left, _bottom);
+	glEnd();
+	glDisable(GL_TEXTURE_2D);
+}
+
+void DrawTiles(int level)
+{
+	/**
+	@Desc : Draws every visible tile of a pyramid level as a quad coloured from its state counts
+	@param1 : pyramid level to draw (tiles of 2^level x 2^level cells)
+	*/
+
+	int _size = 1 << level;
+	int _startX, _startY, _endX, _endY;
+	ScreenToCell(0, 0, _startX, _startY);
+	ScreenToCell(g_viewWidth, g_viewHeight, _endX, _endY);
+	_startX = _startX < 0 ? 0 : _startX / _size;
+	_startY = _startY < 0 ? 0 : _startY / _size;
+	_endX = _endX / _size;
+	_endY = _endY / _size;
+	if (_endX > g_pyramid.TilesX(level) - 1) _endX = g_pyramid.TilesX(level) - 1;
+	if (_endY > g_pyramid.TilesY(level) - 1) _endY = g_pyramid.TilesY(level) - 1;
+
+	float _tileSize = _size * g_zoom;
+	glBegin(GL_QUADS);
+	for (int tx = _startX; tx <= _endX; tx++)
 	{
-		for (int y = 0; y < g_windowHeight; y++)
+		float _left = (tx * _size - g_panX) * g_zoom;
+		for (int ty = _startY; ty <= _endY; ty++)
 		{
-			if (g_quad[x][y] == HEALTHY)
-			{
-				// Healthy cells are green
-				glColor3f(0, 0.5, 0);
-				_healthyCount++;
+			float _top = (ty * _size - g_panY) * g_zoom;
+			int _counts[3];
+			int _total = 0;
+			int _majority = 0;
+			for (int s = 0; s < 3; s++) {
+				_counts[s] = g_pyramid.Count(level, tx, ty, s);
+				_total += _counts[s];
+				if (_counts[s] > _counts[_majority])
+					_majority = s;
 			}
-			else if (g_quad[x][y] == CANCER)
-			{
-				// Cancer cells are red
-				glColor3f(1, 0, 0);
-				_cancerCount++;
+			if (_total == 0)
+				continue;
+
+			if (g_densityColours) {
+				// Blend the state colours by the fraction of cells in each state
+				float _colour[3] = { 0, 0, 0 };
+				for (int s = 0; s < 3; s++) {
+					for (int c = 0; c < 3; c++)
+						_colour[c] += g_stateColours[s][c] * _counts[s] / _total;
+				}
+				glColor3f(_colour[0], _colour[1], _colour[2]);
 			}
-			else if (g_quad[x][y] == MEDICINE)
-			{
-				// Medicine cells are yellow
-				glColor3f(1, 1, 0);
-				_medicineCount++;
+			else {
+				const float *_colour = g_stateColours[_majority];
+				glColor3f(_colour[0], _colour[1], _colour[2]);
 			}
-			glVertex2f(x, y);
-			glVertex2f(x + 1, y);
-			glVertex2f(x + 1, y + 1);
-			glVertex2f(x, y + 1);
+			glVertex2f(_left, _top);
+			glVertex2f(_left + _tileSize, _top);
+			glVertex2f(_left + _tileSize, _top + _tileSize);
+			glVertex2f(_left, _top + _tileSize);
 		}
 	}
 	glEnd();
+}
+
+void Display()
+{
+	/**
+	@Desc : Displays the cells and text in a window on screen
+	*/
+
+	g_pacer.FrameDrawn();
+
+	// Display the cells using OpenGL
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glLoadIdentity();
+
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	gluOrtho2D(0, g_viewWidth, g_viewHeight, 0);
+
+	glClearColor(1, 1, 1,1);
+	glClear(GL_COLOR_BUFFER_BIT);
+	// Only what is inside the window is drawn, so the cost depends on the window size rather than the area size
+	int _level = ViewLevel();
+	if (_level == 0)
+		DrawCells();
+	else
+		DrawTiles(_level);
+
+	// Totals come from the top of the pyramid instead of counting every cell
+	int _healthyCount = g_pyramid.Total(HEALTHY);
+	int _cancerCount = g_pyramid.Total(CANCER);
+	int _medicineCount = g_pyramid.Total(MEDICINE);
 
 	std::string _hCount = std::to_string(_healthyCount);
 	const char * _hc = _hCount.c_str();
@@ -108,11 +419,37 @@ void Display()
 	RenderBitmapString(0, 120, (void *)g_font, _cc);
 	RenderBitmapString(0, 170, (void *)g_font, "Medicine: ");
 	RenderBitmapString(0, 190, (void *)g_font, _mc);
+
+	// Display the tick mode, generation rate and how far the simulation is behind schedule
+	std::string _rate = std::to_string((long long)(g_generationRate + 0.5));
+	std::string _lag = std::to_string((long long)g_tickLag) + " ms";
+	RenderBitmapString(0, 240, (void *)g_font, "Mode: ");
+	RenderBitmapString(0, 260, (void *)g_font, g_tickModeNames[g_tickMode]);
+	RenderBitmapString(0, 310, (void *)g_font, "Generations/s: ");
+	RenderBitmapString(0, 330, (void *)g_font, _rate.c_str());
+	if (g_tickMode == FIXED_RATE) {
+		RenderBitmapString(0, 380, (void *)g_font, "Lag: ");
+		RenderBitmapString(0, 400, (void *)g_font, _lag.c_str());
+	}
 	glPopMatrix();
 
 	glutSwapBuffers();
 }
 
+void Reshape(int width, int height)
+{
+	/**
+	@Desc : Function that handles the window being resized
+	@param1 : new width of the window
+	@param2 : new height of the window
+	*/
+
+	g_viewWidth = width;
+	g_viewHeight = height > 0 ? height : 1;
+	glViewport(0, 0, g_viewWidth, g_viewHeight);
+	g_pacer.RequestRedisplay();
+}
+
 void HealSurroundingMedicine(int x, int y)
 {
 	/**
@@ -121,7 +458,7 @@ void HealSurroundingMedicine(int x, int y)
 	@param2 : y position of current cell
 	*/
 
-	g_quad[x][y] = HEALTHY;
+	SetCell(x, y, HEALTHY);
 	if (x > 0 && y > 0) {
 		if (g_quad[x - 1][y - 1] == MEDICINE)
 			HealSurroundingMedicine(x - 1, y - 1);
@@ -223,7 +560,7 @@ void UpdateState(int x, int y, int state)
 			if (state == CANCER)
 				HealSurroundingMedicine(x, y);
 			else
-				g_quad[x][y] = _after;
+				SetCell(x, y, _after);
 		}
 	}
 }
@@ -238,36 +575,185 @@ void InitThread(int startX, int startY, int endX, int endY)
 	@param4 : y position of last cell that current thread will update
 	*/
 
-	// Update each cell that the current thread manages
+	// Update each cell that the current thread manages, one column at a time.
+	// The column is split at tile borders: a stretch whose tile had nothing change around it, neither last
+	// generation nor earlier in this one, cannot change and is skipped. Cells are updated in place, so
+	// the changes earlier in this generation have to be checked too for the result to stay the same
 	for (int i = startX; i < endX; i++)
+	{
+		int _tileX = i / g_tileSize;
+		for (int j = startY; j < endY; )
 		{
-			for (int j = startY; j < endY; j++)
+			int _tileY = j / g_tileSize;
+			int _endY = (_tileY + 1) * g_tileSize < endY ? (_tileY + 1) * g_tileSize : endY;
+			if (g_skipStableTiles && !g_activity.IsActive(_tileX, _tileY) && !g_activity.ChangedAround(_tileX, _tileY)) {
+				j = _endY;
+				continue;
+			}
+			for (; j < _endY; j++)
 			{
 				UpdateState(i, j, g_quad[i][j]);
 			}
 		}
+	}
 }
 
-void Update(int value)
+void ApplyInjection(int x, int y)
+{
+	/**
+	@Desc : Injects medicine into a cell (only called between generations)
+	@param1 : x position of injected cell
+	@param2 : y position of injected cell
+	*/
+
+	// If medicine is injected on a cancer cell,
+	// the medicine is absorbed and the cell turns into a healthy cell
+	if (g_quad[x][y] == CANCER) {
+		SetCell(x, y, HEALTHY);
+	}
+	// If medicine is injected on a healthy or medicine cell,
+	// the medicine is not absorbed and propagates radially outwards by one cell
+	else {
+		SetCell(x, y, MEDICINE);
+		if (x > 0 && y > 0)
+			SetCell(x - 1, y - 1, MEDICINE);
+		if (y > 0)
+			SetCell(x, y - 1, MEDICINE);
+		if (x < (g_windowWidth - 1) && y > 0)
+			SetCell(x + 1, y - 1, MEDICINE);
+		if (x > 0)
+			SetCell(x - 1, y, MEDICINE);
+		if (x < (g_windowWidth - 1))
+			SetCell(x + 1, y, MEDICINE);
+		if (x > 0 && y < (g_windowHeight - 1))
+			SetCell(x - 1, y + 1, MEDICINE);
+		if (y < (g_windowHeight - 1))
+			SetCell(x, y + 1, MEDICINE);
+		if (x < (g_windowWidth - 1) && y < (g_windowHeight - 1))
+			SetCell(x + 1, y + 1, MEDICINE);
+	}
+}
+
+void DrainInjections()
+{
+	/**
+	@Desc : Applies all pending injections in one batch (called at each generation boundary, before the update threads start)
+	*/
+
+	// Replayed injections go in at the same generation they were recorded at
+	while (g_replayNext < g_replay.size() && g_replay[g_replayNext].generation <= g_generation) {
+		ApplyInjection(g_replay[g_replayNext].x, g_replay[g_replayNext].y);
+		g_replayNext++;
+	}
+
+	InjectionEvent _event;
+	while (g_injections.Pop(_event)) {
+		_event.generation = g_generation;
+		ApplyInjection(_event.x, _event.y);
+		if (g_recordFile.is_open())
+			g_recordFile << _event.generation << " " << _event.x << " " << _event.y << " " << _event.timestamp << "\n";
+	}
+}
+
+void RunGeneration()
 {
 	/**
-	@Desc : Function that creates each thread, joins them, and then calls itself (to update again)
-	@param1 : unused parameter that is passed by the glutTimerFunc
+	@Desc : Computes one generation: applies pending injections, then creates each thread and joins them
 	*/
 
+	// Apply the injections that arrived since the last generation
+	DrainInjections();
+	// The injected cells were marked as changed, so the tiles around them are woken up too
+	g_statActiveTiles += g_activity.BeginGeneration();
+
 	std::thread threads[4];
 
 	// Create 4 threads: one to manage each quadrant of the cell area
-	threads[0] = std::thread(InitThread, 0, 0, 513, 385);
-	threads[1] = std::thread(InitThread, 512, 0, 1024, 385);
-	threads[2] = std::thread(InitThread, 0, 384, 513, 768);
+	threads[0] = std::thread(InitThread, 0, 0, 512, 384);
+	threads[1] = std::thread(InitThread, 512, 0, 1024, 384);
+	threads[2] = std::thread(InitThread, 0, 384, 512, 768);
 	threads[3] = std::thread(InitThread, 512, 384, 1024, 768);
 
 	for (int i = 0; i < 4; i++)
 		threads[i].join();
+	g_generation++;
+	g_pacer.GenerationsDone(1);
+	g_rateGenerations++;
+	ReportFrameStats();
 
-	glutPostRedisplay();
-	glutTimerFunc(g_updateTime, Update, 0);
+	// Refresh the generation rate shown on screen
+	double _elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - g_rateStart).count();
+	if (_elapsed >= 0.5) {
+		g_generationRate = g_rateGenerations / _elapsed;
+		g_rateGenerations = 0;
+		g_rateStart = std::chrono::steady_clock::now();
+	}
+
+	g_pacer.RequestRedisplay();
+}
+
+void Update(int value)
+{
+	/**
+	@Desc : Function that runs the generations that are due in the current tick mode, and then schedules itself (to update again)
+	@param1 : epoch of the tick mode this callback was scheduled for
+	*/
+
+	if (value != g_tickEpoch)
+		return;
+
+	std::chrono::steady_clock::time_point _now = std::chrono::steady_clock::now();
+	if (g_tickMode == FIXED_RATE) {
+		// Run every generation that is due, a few at most so drawing and input still get a turn
+		int _count = 0;
+		while (_now >= g_nextTick && _count < g_maxCatchUp) {
+			RunGeneration();
+			g_nextTick += std::chrono::milliseconds(g_updateTime);
+			_count++;
+			_now = std::chrono::steady_clock::now();
+		}
+
+		// Drop a backlog that cannot be caught up instead of running flat out forever
+		g_tickLag = std::chrono::duration<double, std::milli>(_now - g_nextTick).count();
+		if (g_tickLag > g_maxLag) {
+			g_nextTick = _now;
+			g_tickLag = 0.0;
+		}
+
+		int _wait = g_tickLag < 0 ? (int)-g_tickLag : 0;
+		glutTimerFunc(_wait, Update, g_tickEpoch);
+	}
+	else if (g_tickMode == MAX_THROUGHPUT) {
+		// Keep running generations until the next frame is due, then let GLUT draw it
+		std::chrono::steady_clock::time_point _frameEnd = _now + std::chrono::milliseconds(g_pacer.Interval());
+		do {
+			RunGeneration();
+		} while (std::chrono::steady_clock::now() < _frameEnd);
+
+		g_tickLag = 0.0;
+		glutTimerFunc(0, Update, g_tickEpoch);
+	}
+}
+
+void SetTickMode(TickMode mode)
+{
+	/**
+	@Desc : Switches how generations are scheduled
+	@param1 : new tick mode
+	*/
+
+	g_tickMode = mode;
+	g_tickLag = 0.0;
+	g_generationRate = 0.0;
+	g_rateGenerations = 0;
+	g_rateStart = std::chrono::steady_clock::now();
+	g_nextTick = g_rateStart;
+
+	// Callbacks already scheduled for the previous mode become stale
+	g_tickEpoch++;
+	if (mode != STEP)
+		glutTimerFunc(0, Update, g_tickEpoch);
+	g_pacer.RequestRedisplay();
 }
 
 void Initialize()
@@ -283,6 +769,44 @@ void Initialize()
 	GLfloat aspect = (GLfloat)g_windowWidth / g_windowHeight;
 	gluPerspective(45, aspect, 0.1f, 10.0f);
 	glClearColor(0.0, 0.0, 0.0, 0.0);
+
+	// Texture the visible cells are drawn with, one texel per cell
+	glGenTextures(1, &g_texture);
+	glBindTexture(GL_TEXTURE_2D, g_texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void QueueInjection(int sx, int sy)
+{
+	/**
+	@Desc : Turns a click on the window into an injection event for the simulation thread
+	@param1 : x position of pointer
+	@param2 : y position of pointer
+	*/
+
+	int x, y;
+	ScreenToCell(sx, sy, x, y);
+
+	// Ignore clicks and drags that end up outside of the cell area
+	if (x < 0 || y < 0 || x >= g_windowWidth || y >= g_windowHeight)
+		return;
+	// Dragging generates many motion events per cell, only inject once per cell
+	if (x == g_lastInjectX && y == g_lastInjectY)
+		return;
+	g_lastInjectX = x;
+	g_lastInjectY = y;
+
+	InjectionEvent _event;
+	_event.x = x;
+	_event.y = y;
+	_event.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - g_startTime).count();
+	_event.generation = -1;
+	// If the queue is full the click is dropped rather than blocking the GLUT thread
+	g_injections.Push(_event);
 }
 
 void MouseClicks(int button, int state, int x, int y)
@@ -295,36 +819,156 @@ void MouseClicks(int button, int state, int x, int y)
 	@param4 : y position of pointer when mouse was clicked
 	*/
 
-	if (button == GLUT_LEFT_BUTTON && state == GLUT_DOWN) {
-		// If medicine is injected on a cancer cell,
-		// the medicine is absorbed and the cell turns into a healthy cell
-		if (g_quad[x][y] == CANCER) {
-			g_quad[x][y] = HEALTHY;
-		}
-		// If medicine is injected on a healthy or medicine cell,
-		// the medicine is not absorbed and propagates radially outwards by one cell
-		else {
-			g_quad[x][y] = MEDICINE;
-			if (x > 0 && y > 0)
-				g_quad[x - 1][y - 1] = MEDICINE;
-			if (y > 0)
-				g_quad[x][y - 1] = MEDICINE;
-			if (x < (g_windowWidth - 1) && y > 0)
-				g_quad[x + 1][y - 1] = MEDICINE;
-			if (x > 0)
-				g_quad[x - 1][y] = MEDICINE;
-			if (x < (g_windowWidth - 1))
-				g_quad[x + 1][y] = MEDICINE;
-			if (x > 0 && y < (g_windowHeight - 1))
-				g_quad[x - 1][y + 1] = MEDICINE;
-			if (y < (g_windowHeight - 1))
-				g_quad[x][y + 1] = MEDICINE;
-			if (x < (g_windowWidth - 1) && y < (g_windowHeight - 1))
-				g_quad[x + 1][y + 1] = MEDICINE;
+	if (button == GLUT_LEFT_BUTTON) {
+		g_mouseDown = (state == GLUT_DOWN);
+		g_lastInjectX = -1;
+		g_lastInjectY = -1;
+		if (state == GLUT_DOWN)
+			QueueInjection(x, y);
+	}
+	// Right button drags the view around
+	else if (button == GLUT_RIGHT_BUTTON) {
+		g_panning = (state == GLUT_DOWN);
+		g_panLastX = x;
+		g_panLastY = y;
+	}
+	// Mouse wheel zooms around the pointer (GLUT reports the wheel as buttons 3 and 4)
+	else if (button == 3 && state == GLUT_DOWN) {
+		ZoomAt(g_zoom * 1.25f, x, y);
+	}
+	else if (button == 4 && state == GLUT_DOWN) {
+		ZoomAt(g_zoom / 1.25f, x, y);
+	}
+}
+
+void MouseMotion(int x, int y)
+{
+	/**
+	@Desc : Function that handles the mouse being dragged with a button held down
+	@param1 : x position of pointer
+	@param2 : y position of pointer
+	*/
+
+	if (g_mouseDown)
+		QueueInjection(x, y);
+	if (g_panning) {
+		g_panX -= (x - g_panLastX) / g_zoom;
+		g_panY -= (y - g_panLastY) / g_zoom;
+		g_panLastX = x;
+		g_panLastY = y;
+		g_pacer.RequestRedisplay();
+	}
+}
+
+bool ParseNumber(const std::string &text, unsigned long maximum, unsigned long &value)
+{
+	/**
+	@Desc : Reads a command line value made of decimal digits only
+	@param1 : text of the value
+	@param2 : largest accepted value
+	@param3 : receives the value
+	@return : false if the text is empty, holds anything but digits or is larger than maximum
+	*/
+
+	if (text.empty() || text.size() > 10 || text.find_first_not_of("0123456789") != std::string::npos)
+		return false;
+	unsigned long long _value = strtoull(text.c_str(), NULL, 10);
+	if (_value > maximum)
+		return false;
+	value = (unsigned long)_value;
+	return true;
+}
+
+bool LoadReplay(const std::string &path)
+{
+	/**
+	@Desc : Loads injections recorded with --record so a run can be reproduced
+	@param1 : path of the recording
+	@return : false if the file could not be opened
+	*/
+
+	std::ifstream _file(path.c_str());
+	if (!_file.is_open())
+		return false;
+
+	// First line holds the seed of the recorded run
+	std::string _tag;
+	_file >> _tag >> g_seed;
+
+	InjectionEvent _event;
+	while (_file >> _event.generation >> _event.x >> _event.y >> _event.timestamp) {
+		if (_event.x >= 0 && _event.y >= 0 && _event.x < g_windowWidth && _event.y < g_windowHeight)
+			g_replay.push_back(_event);
+	}
+	return true;
+}
+
+void ExportImage()
+{
+	/**
+	@Desc : Saves the whole cell area as a PPM image named after the current generation
+	*/
+
+	std::vector<unsigned int> _image(g_windowWidth * g_windowHeight);
+	ConvertToRGBA(QuadCells(), g_windowHeight, 0, 0, g_windowWidth, g_windowHeight, &_image[0], g_palette, g_numThreads);
+
+	std::string _name = "generation_" + std::to_string((long long)g_generation) + ".ppm";
+	std::ofstream _file(_name.c_str(), std::ios::binary);
+	_file << "P6\n" << g_windowWidth << " " << g_windowHeight << "\n255\n";
+	for (size_t i = 0; i < _image.size(); i++) {
+		char _rgb[3] = { (char)(_image[i] & 0xFF), (char)((_image[i] >> 8) & 0xFF), (char)((_image[i] >> 16) & 0xFF) };
+		_file.write(_rgb, 3);
+	}
+}
+
+void BenchmarkPalette()
+{
+	/**
+	@Desc : Times the cell to pixel conversion on its own (--bench-palette): scalar, then the variant picked for this CPU
+	(AVX2, SSSE3 or scalar again) on one thread and on every thread
+	*/
+
+	for (int x = 0; x < g_windowWidth; x++)
+	{
+		for (int y = 0; y < g_windowHeight; y++)
+			g_quad[x][y] = rand() % 3;
+	}
+
+	const int _iterations = 200;
+	std::vector<unsigned int> _reference(g_windowWidth * g_windowHeight);
+	std::vector<unsigned int> _image(g_windowWidth * g_windowHeight);
+	ConvertToRGBAScalar(QuadCells(), g_windowHeight, 0, 0, g_windowWidth, g_windowHeight, &_reference[0], g_palette);
+
+	for (int run = 0; run < 3; run++) {
+		int _threads = run == 2 ? g_numThreads : 1;
+		std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+		for (int i = 0; i < _iterations; i++) {
+			if (run == 0)
+				ConvertToRGBAScalar(QuadCells(), g_windowHeight, 0, 0, g_windowWidth, g_windowHeight, &_image[0], g_palette);
+			else
+				ConvertToRGBA(QuadCells(), g_windowHeight, 0, 0, g_windowWidth, g_windowHeight, &_image[0], g_palette, _threads);
 		}
+		double _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+		double _cells = (double)g_windowWidth * g_windowHeight * _iterations;
+		printf("%-6s %2d thread(s): %7.3f ms/frame, %8.1f Mcells/s%s\n", run == 0 ? "scalar" : PaletteInstructionSet(), _threads,
+			_seconds * 1000.0 / _iterations, _cells / _seconds / 1e6, _image == _reference ? "" : " (MISMATCH)");
 	}
 }
 
+void SetPacer(bool enabled)
+{
+	/**
+	@Desc : Switches between drawing on change and redrawing continuously from the idle function
+	@param1 : true to only draw when something changed
+	*/
+
+	g_pacer.SetEnabled(enabled);
+	glutIdleFunc(enabled ? NULL : Display);
+	// Each report only covers one mode
+	ResetFrameStats();
+	glutPostRedisplay();
+}
+
 void Keyboard ( unsigned char key, int mousePositionX, int mousePositionY )
 {
 	/**
@@ -341,23 +985,164 @@ void Keyboard ( unsigned char key, int mousePositionX, int mousePositionY )
 		exit ( 0 );
 		break;
 
+	// Toggle the frame pacer
+	case 'p':
+		SetPacer(!g_pacer.Enabled());
+		break;
+
+	// Zoom in and out around the centre of the window
+	case '+':
+	case '=':
+		ZoomAt(g_zoom * 1.25f, g_viewWidth / 2, g_viewHeight / 2);
+		break;
+	case '-':
+		ZoomAt(g_zoom / 1.25f, g_viewWidth / 2, g_viewHeight / 2);
+		break;
+
+	// Fit the whole area in the window again
+	case 'r':
+		ResetView();
+		break;
+
+	// Save the cells as an image
+	case 'e':
+		ExportImage();
+		break;
+
+	// Switch zoomed-out colouring between majority state and density
+	case 'c':
+		g_densityColours = !g_densityColours;
+		g_pacer.RequestRedisplay();
+		break;
+
+	// Cycle through fixed rate, max throughput and step
+	case 'm':
+		SetTickMode((TickMode)((g_tickMode + 1) % 3));
+		break;
+
+	// Advance one generation in step mode
+	case ' ':
+	case 's':
+		if (g_tickMode == STEP)
+			RunGeneration();
+		break;
+
 	default:
 		break;
 	}
 }
 
+void SpecialKeys(int key, int mousePositionX, int mousePositionY)
+{
+	/**
+	@Desc : Function that handles special keys (arrows) being pressed
+	@param1 : key that was pressed
+	@param2 : x position of mouse pointer
+	@param3 : y position of mouse pointer
+	*/
+
+	// Arrow keys pan by a tenth of the window
+	float _stepX = g_viewWidth / 10.0f / g_zoom;
+	float _stepY = g_viewHeight / 10.0f / g_zoom;
+	switch (key)
+	{
+	case GLUT_KEY_LEFT:
+		g_panX -= _stepX;
+		break;
+	case GLUT_KEY_RIGHT:
+		g_panX += _stepX;
+		break;
+	case GLUT_KEY_UP:
+		g_panY -= _stepY;
+		break;
+	case GLUT_KEY_DOWN:
+		g_panY += _stepY;
+		break;
+	default:
+		return;
+	}
+	g_pacer.RequestRedisplay();
+}
+
 int main(int argc, char **argv)
 {
 	/**
 	@Desc : Main control thread
 	*/
 
+	// Palette shared by the texture, image export and the benchmark
+	for (int s = 0; s < 3; s++)
+		g_palette[s] = PackRGBA(g_stateColours[s][0], g_stateColours[s][1], g_stateColours[s][2]);
+	g_palette[3] = 0;
+	if (std::thread::hardware_concurrency() > 0)
+		g_numThreads = std::thread::hardware_concurrency();
+
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--bench-palette") {
+			BenchmarkPalette();
+			return 0;
+		}
+	}
+
 	// initialize
 	glutInit(&argc, argv);
 	glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH );
-	glutInitWindowSize(g_windowWidth, g_windowHeight);
+	// The window starts at the size of the cell area, but no larger than the screen
+	int _screenWidth = glutGet(GLUT_SCREEN_WIDTH);
+	int _screenHeight = glutGet(GLUT_SCREEN_HEIGHT);
+	if (_screenWidth > 0 && g_viewWidth > _screenWidth * 9 / 10)
+		g_viewWidth = _screenWidth * 9 / 10;
+	if (_screenHeight > 0 && g_viewHeight > _screenHeight * 9 / 10)
+		g_viewHeight = _screenHeight * 9 / 10;
+	glutInitWindowSize(g_viewWidth, g_viewHeight);
 	glutCreateWindow("2D Cell Growth Simulation");
 
+	// Parse the remaining command line options
+	g_seed = (unsigned int)time(NULL);
+	g_pacer.SetInterval(1000 / MonitorRefreshRate());
+	for (int i = 1; i < argc; i++) {
+		std::string _arg = argv[i];
+		if (_arg == "--no-pacer") {
+			g_pacer.SetEnabled(false);
+		}
+		else if (_arg == "--max-throughput") {
+			g_tickMode = MAX_THROUGHPUT;
+		}
+		else if (_arg == "--step") {
+			g_tickMode = STEP;
+		}
+		else if (_arg == "--no-tile-skip") {
+			g_skipStableTiles = false;
+		}
+		else if (_arg.compare(0, 10, "--refresh=") == 0) {
+			int _interval;
+			if (!FrameIntervalFromRate(_arg.substr(10), _interval)) {
+				printf("Error: --refresh= expects a refresh rate in Hz above 0!\n");
+				return 1;
+			}
+			g_pacer.SetInterval(_interval);
+		}
+		else if (_arg.compare(0, 7, "--seed=") == 0) {
+			unsigned long _seed;
+			if (!ParseNumber(_arg.substr(7), 0xFFFFFFFFUL, _seed)) {
+				printf("Error: --seed= expects a number from 0 to 4294967295!\n");
+				return 1;
+			}
+			g_seed = (unsigned int)_seed;
+		}
+		else if (_arg.compare(0, 9, "--record=") == 0) {
+			g_recordFile.open(_arg.substr(9).c_str());
+		}
+		else if (_arg.compare(0, 9, "--replay=") == 0) {
+			if (!LoadReplay(_arg.substr(9))) {
+				printf("Error: Could not open the replay %s!\n", _arg.substr(9).c_str());
+				return 1;
+			}
+		}
+	}
+	if (g_recordFile.is_open())
+		g_recordFile << "seed " << g_seed << "\n";
+
 	// Initialize all cells as healthy cells
 	for (int i = 0; i < 1024; i++)
 	{
@@ -368,7 +1153,7 @@ int main(int argc, char **argv)
 	}
 
 	// Initialize random seed
-	srand(time(NULL));
+	srand(g_seed);
 
 	// Change at least 25% of cells to cancer cells
 	for (int i = 0; i <= g_initialCancer; i++)
@@ -381,13 +1166,31 @@ int main(int argc, char **argv)
 			g_quad[x][y] = CANCER;
 	}
 
+	// Count the initial cells for each tile
+	for (int x = 0; x < g_windowWidth; x++)
+	{
+		for (int y = 0; y < g_windowHeight; y++)
+			g_pyramid.Add(x, y, g_quad[x][y]);
+	}
+	// Every tile is new, so the first generation updates all of them
+	g_activity.MarkAll();
+	ResetView();
+
 	glutDisplayFunc(Display);
-	glutIdleFunc(Display);
+	// Redraws are requested by RequestRedisplay, the idle function is only used with the pacer off
+	if (!g_pacer.Enabled())
+		glutIdleFunc(Display);
 	glutMouseFunc(MouseClicks);
+	glutMotionFunc(MouseMotion);
 	glutKeyboardFunc(Keyboard);
-	glutTimerFunc(g_updateTime, Update, 0);
+	glutSpecialFunc(SpecialKeys);
+	glutReshapeFunc(Reshape);
 	Initialize();
 
+	g_startTime = std::chrono::steady_clock::now();
+
+	ResetFrameStats();
+	SetTickMode(g_tickMode);
 	glutMainLoop();
 	return 0;
 }
\ No newline at end of file
@@ -6,7 +6,12 @@
 #include "tbb/parallel_for.h"
 #include "tbb/blocked_range.h"
 #include "tbb/blocked_range2d.h"
+#include "FramePacer.h"
 #include <string>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
 
 // Define states for cells
 #define HEALTHY  0
@@ -18,6 +23,17 @@ const int g_windowWidth = 1024;
 const int g_windowHeight = 768;
 int g_quad[g_windowWidth][g_windowHeight];
 
+// Tiles of 32 x 32 cells. A cell only changes when a cell around it changed since it was last updated, so only
+// the tiles that changed, or border one that did, are updated; every other tile is stable and skipped.
+// Cells are updated in place, so the changes of the last generation (g_tileActive) and the changes earlier
+// in the current generation (g_tileChanged) both count
+const int g_tileSize = 32;
+const int g_tilesX = (g_windowWidth + g_tileSize - 1) / g_tileSize;
+const int g_tilesY = (g_windowHeight + g_tileSize - 1) / g_tileSize;
+std::atomic<bool> g_tileChanged[g_tilesX][g_tilesY];
+bool g_tileActive[g_tilesX][g_tilesY];
+bool g_skipStableTiles = true;
+
 // Update every 1/30th second
 const int g_updateTime = 1.0 / 30.0 * 1000.0;
 
@@ -26,8 +42,94 @@ const int g_initialCancer = g_windowWidth * g_windowHeight * 0.26;
 
 const int g_font = (int)GLUT_BITMAP_TIMES_ROMAN_24;
 
+// Frames are only drawn when a new generation or an input event arrives, at most once per monitor refresh.
+// The pacer also prints the throughput and CPU usage every few seconds
+FramePacer g_pacer;
+
+// Active tiles summed over the generations of the current measurement interval
+long long g_statActiveTiles = 0;
+
 const size_t init_size = 0;
 
+void SetCell(int x, int y, int state)
+{
+	/**
+	@Desc : Changes the state of a cell and marks its tile as changed (safe to call from several threads)
+	@param1 : x position of cell
+	@param2 : y position of cell
+	@param3 : new state of cell
+	*/
+
+	if (g_quad[x][y] != state) {
+		g_quad[x][y] = state;
+		std::atomic<bool> &_changed = g_tileChanged[x / g_tileSize][y / g_tileSize];
+		// Most changes land on a tile that is already marked, so avoid writing to a shared cache line
+		if (!_changed.load(std::memory_order_relaxed))
+			_changed.store(true, std::memory_order_relaxed);
+	}
+}
+
+void MarkAllTiles()
+{
+	/**
+	@Desc : Marks every tile as changed, so every tile is updated in the next generation
+	*/
+
+	for (int tx = 0; tx < g_tilesX; tx++)
+	{
+		for (int ty = 0; ty < g_tilesY; ty++)
+			g_tileChanged[tx][ty].store(true, std::memory_order_relaxed);
+	}
+}
+
+bool TileChangedAround(int tx, int ty)
+{
+	/**
+	@Desc : Checks the changed flags of a tile and of the 8 tiles around it
+	@param1 : x position of the tile
+	@param2 : y position of the tile
+	@return : whether any of them changed since the last BeginGeneration
+	*/
+
+	for (int nx = (tx > 0 ? tx - 1 : 0); nx <= (tx < g_tilesX - 1 ? tx + 1 : tx); nx++)
+	{
+		for (int ny = (ty > 0 ? ty - 1 : 0); ny <= (ty < g_tilesY - 1 ? ty + 1 : ty); ny++)
+		{
+			if (g_tileChanged[nx][ny].load(std::memory_order_relaxed))
+				return true;
+		}
+	}
+	return false;
+}
+
+int BeginGeneration()
+{
+	/**
+	@Desc : Activates every tile that changed or borders a tile that changed since the last generation, then clears
+	the changed flags (called between generations, while no thread is updating cells)
+	@return : number of active tiles
+	*/
+
+	int _numActive = 0;
+	for (int tx = 0; tx < g_tilesX; tx++)
+	{
+		for (int ty = 0; ty < g_tilesY; ty++)
+		{
+			bool _active = TileChangedAround(tx, ty);
+			g_tileActive[tx][ty] = _active;
+			if (_active)
+				_numActive++;
+		}
+	}
+
+	for (int tx = 0; tx < g_tilesX; tx++)
+	{
+		for (int ty = 0; ty < g_tilesY; ty++)
+			g_tileChanged[tx][ty].store(false, std::memory_order_relaxed);
+	}
+	return _numActive;
+}
+
 void HealSurroundingMedicine(int x, int y)
 {
 	/**
@@ -36,7 +138,7 @@ void HealSurroundingMedicine(int x, int y)
 	@param2 : y position of current cell
 	*/
 
-	g_quad[x][y] = HEALTHY;
+	SetCell(x, y, HEALTHY);
 	if (x > 0 && y > 0) {
 		if (g_quad[x - 1][y - 1] == MEDICINE)
 			HealSurroundingMedicine(x - 1, y - 1);
@@ -138,7 +240,7 @@ void UpdateState(int x, int y, int state)
 			if (state == CANCER)
 				HealSurroundingMedicine(x, y);
 			else
-				g_quad[x][y] = _after;
+				SetCell(x, y, _after);
 		}
 	}
 }
@@ -161,15 +263,55 @@ public:
 		@param1 : TBB 2D blocked range
 		*/
 
-		// Update each cell that the current thread manages
-		for (size_t i = r.cols().begin(); i != r.cols().end(); ++i)
+		// Update each cell of the tiles that the current thread manages (the range is in tiles, x then y).
+		// A tile is skipped when nothing changed around it last generation nor earlier in this one
+		for (size_t tx = r.rows().begin(); tx != r.rows().end(); ++tx)
 		{
-			for (size_t j = r.rows().begin(); j != r.rows().end(); ++j)
-				UpdateState(i, j, g_quad[i][j]);
+			for (size_t ty = r.cols().begin(); ty != r.cols().end(); ++ty)
+			{
+				if (g_skipStableTiles && !g_tileActive[tx][ty] && !TileChangedAround((int)tx, (int)ty))
+					continue;
+				int _startX = (int)tx * g_tileSize;
+				int _startY = (int)ty * g_tileSize;
+				int _endX = _startX + g_tileSize < *endX ? _startX + g_tileSize : *endX;
+				int _endY = _startY + g_tileSize < *endY ? _startY + g_tileSize : *endY;
+				for (int i = _startX; i < _endX; i++)
+				{
+					for (int j = _startY; j < _endY; j++)
+						UpdateState(i, j, g_quad[i][j]);
+				}
+			}
 		}
 	}
 };
 
+void ResetFrameStats()
+{
+	/**
+	@Desc : Starts a new throughput and CPU usage measurement interval
+	*/
+
+	g_pacer.ResetStats();
+	g_statActiveTiles = 0;
+}
+
+void ReportFrameStats()
+{
+	/**
+	@Desc : Prints the pacer measurements once per measurement interval, with the share of active tiles
+	*/
+
+	if (!g_pacer.ReportDue())
+		return;
+
+	// Share of the tiles that had to be updated, which is what a generation costs once the area settles
+	double _active = g_pacer.Generations() > 0 ? 100.0 * g_statActiveTiles / g_pacer.Generations() / (g_tilesX * g_tilesY) : 0.0;
+	char _details[32];
+	sprintf(_details, ", %.1f%% tiles active", g_skipStableTiles ? _active : 100.0);
+	g_pacer.Report(_details);
+	g_statActiveTiles = 0;
+}
+
 void Update(int value)
 {
 	/**
@@ -187,9 +329,14 @@ void Update(int value)
 	tbb::task_scheduler_init init;
 
 	*startX = 0, *endX = g_windowWidth, *startY = 0, *endY = g_windowHeight;
-	tbb::parallel_for(tbb::blocked_range2d<size_t>(*startX, *endX, 1, *startY, *endY, 1), DoUpdate(startX, endX, startY, endY), tbb::auto_partitioner());
+	// Injections since the last generation marked their tiles, so the tiles around them are woken up too
+	g_statActiveTiles += BeginGeneration();
+	tbb::parallel_for(tbb::blocked_range2d<size_t>(0, g_tilesX, 1, 0, g_tilesY, 1), DoUpdate(startX, endX, startY, endY), tbb::auto_partitioner());
 
-	glutPostRedisplay();
+	g_pacer.GenerationsDone(1);
+	ReportFrameStats();
+
+	g_pacer.RequestRedisplay();
 	glutTimerFunc(g_updateTime, Update, 0);
 }
 
@@ -216,6 +363,8 @@ void Display()
 	@Desc : Displays the cells and text in a window on screen
 	*/
 
+	g_pacer.FrameDrawn();
+
 	// Display the cells using OpenGL
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glLoadIdentity();
@@ -312,32 +461,46 @@ void MouseClicks(int button, int state, int x, int y)
 		// If medicine is injected on a cancer cell,
 		// the medicine is absorbed and the cell turns into a healthy cell
 		if (g_quad[x][y] == CANCER) {
-			g_quad[x][y] = HEALTHY;
+			SetCell(x, y, HEALTHY);
 		}
 		// If medicine is injected on a healthy or medicine cell,
 		// the medicine is not absorbed and propagates radially outwards by one cell
 		else {
-			g_quad[x][y] = MEDICINE;
+			SetCell(x, y, MEDICINE);
 			if (x > 0 && y > 0)
-				g_quad[x - 1][y - 1] = MEDICINE;
+				SetCell(x - 1, y - 1, MEDICINE);
 			if (y > 0)
-				g_quad[x][y - 1] = MEDICINE;
+				SetCell(x, y - 1, MEDICINE);
 			if (x < (g_windowWidth - 1) && y > 0)
-				g_quad[x + 1][y - 1] = MEDICINE;
+				SetCell(x + 1, y - 1, MEDICINE);
 			if (x > 0)
-				g_quad[x - 1][y] = MEDICINE;
+				SetCell(x - 1, y, MEDICINE);
 			if (x < (g_windowWidth - 1))
-				g_quad[x + 1][y] = MEDICINE;
+				SetCell(x + 1, y, MEDICINE);
 			if (x > 0 && y < (g_windowHeight - 1))
-				g_quad[x - 1][y + 1] = MEDICINE;
+				SetCell(x - 1, y + 1, MEDICINE);
 			if (y < (g_windowHeight - 1))
-				g_quad[x][y + 1] = MEDICINE;
+				SetCell(x, y + 1, MEDICINE);
 			if (x < (g_windowWidth - 1) && y < (g_windowHeight - 1))
-				g_quad[x + 1][y + 1] = MEDICINE;
+				SetCell(x + 1, y + 1, MEDICINE);
 		}
 	}
 }
 
+void SetPacer(bool enabled)
+{
+	/**
+	@Desc : Switches between drawing on change and redrawing continuously from the idle function
+	@param1 : true to only draw when something changed
+	*/
+
+	g_pacer.SetEnabled(enabled);
+	glutIdleFunc(enabled ? NULL : Display);
+	// Each report only covers one mode
+	ResetFrameStats();
+	glutPostRedisplay();
+}
+
 void Keyboard(unsigned char key, int mousePositionX, int mousePositionY)
 {
 	/**
@@ -354,6 +517,11 @@ void Keyboard(unsigned char key, int mousePositionX, int mousePositionY)
 		exit ( 0 );
 		break;
 
+	// Toggle the frame pacer
+	case 'p':
+		SetPacer(!g_pacer.Enabled());
+		break;
+
 	default:
 		break;
 	}
@@ -371,6 +539,24 @@ int main(int argc, char **argv)
 	glutInitWindowSize(g_windowWidth, g_windowHeight);
 	glutCreateWindow("2D Cell Growth Simulation");
 
+	// Parse the remaining command line options
+	g_pacer.SetInterval(1000 / MonitorRefreshRate());
+	for (int i = 1; i < argc; i++) {
+		std::string _arg = argv[i];
+		if (_arg == "--no-pacer")
+			g_pacer.SetEnabled(false);
+		else if (_arg == "--no-tile-skip")
+			g_skipStableTiles = false;
+		else if (_arg.compare(0, 10, "--refresh=") == 0) {
+			int _interval;
+			if (!FrameIntervalFromRate(_arg.substr(10), _interval)) {
+				printf("Error: --refresh= expects a refresh rate in Hz above 0!\n");
+				return 1;
+			}
+			g_pacer.SetInterval(_interval);
+		}
+	}
+
 	// Initialize all cells as healthy cells
 	for (int i = 0; i < 1024; i++)
 	{
@@ -393,14 +579,19 @@ int main(int argc, char **argv)
 		else
 			g_quad[x][y] = CANCER;
 	}
+	// Every tile is new, so the first generation updates all of them
+	MarkAllTiles();
 
 	glutDisplayFunc(Display);
-	glutIdleFunc(Display);
+	// Redraws are requested by RequestRedisplay, the idle function is only used with the pacer off
+	if (!g_pacer.Enabled())
+		glutIdleFunc(Display);
 	glutMouseFunc(MouseClicks);
 	glutKeyboardFunc(Keyboard);
 	glutTimerFunc(g_updateTime, Update, 0);
 	Initialize();
 
+	ResetFrameStats();
 	glutMainLoop();
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "CpuLauncher.h"
+#include "UpdateCell.h"
+
+CpuLauncher::CpuLauncher(int threads)
+	: launch(0), stopping(false), devRead(0), devWrite(0), width(0), height(0), blockX(1), blockY(1), gridX(0), numBlocks(0),
+	nextBlock(0), busyWorkers(0)
+{
+	/**
+	@Desc : Starts the pool of threads
+	@param1 : number of threads running blocks, the calling thread included (0 for one per core)
+	*/
+
+	if (threads <= 0)
+		threads = (int)std::thread::hardware_concurrency();
+	for (int i = 1; i < threads; i++)
+		workers.push_back(std::thread(&CpuLauncher::Worker, this));
+}
+
+CpuLauncher::~CpuLauncher()
+{
+	/**
+	@Desc : Stops the pool of threads
+	*/
+
+	{
+		std::lock_guard<std::mutex> _lock(mutex);
+		stopping = true;
+	}
+	start.notify_all();
+	for (std::size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+void CpuLauncher::Worker()
+{
+	/**
+	@Desc : Thread of the pool, helps with every launch until the launcher is destroyed
+	*/
+
+	int _seen = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> _lock(mutex);
+			start.wait(_lock, [&] { return stopping || launch != _seen; });
+			if (stopping)
+				return;
+			_seen = launch;
+		}
+		RunBlocks();
+		{
+			std::lock_guard<std::mutex> _lock(mutex);
+			busyWorkers--;
+		}
+		done.notify_one();
+	}
+}
+
+void CpuLauncher::RunBlocks()
+{
+	/**
+	@Desc : Runs blocks of the current launch until none are left
+	*/
+
+	for (int b = nextBlock++; b < numBlocks; b = nextBlock++) {
+		int _blockIdxX = b % gridX;
+		int _blockIdxY = b / gridX;
+		// Threads of the block, as updateKernel computes its cell from blockDim, blockIdx and threadIdx
+		for (int _threadIdxY = 0; _threadIdxY < blockY; _threadIdxY++) {
+			for (int _threadIdxX = 0; _threadIdxX < blockX; _threadIdxX++) {
+				int x = blockX * _blockIdxX + _threadIdxX;
+				int y = blockY * _blockIdxY + _threadIdxY;
+				if (x < width && y < height)
+					UpdateCell(devRead, devWrite, x, y, width, height);
+			}
+		}
+	}
+}
+
+void CpuLauncher::Launch(const int *devRead, int *devWrite, int width, int height, int blockX, int blockY)
+{
+	/**
+	@Desc : Runs updateKernel over the whole grid on the CPU and returns when every cell is done
+	(the counterpart of updateKernel<<<dimGrid, dimBlock>>> followed by cudaDeviceSynchronize)
+	@param1 : pointer to read array
+	@param2 : pointer to write array
+	@param3 : width of the grid
+	@param4 : height of the grid
+	@param5 : threads per block along x (dimBlock.x)
+	@param6 : threads per block along y (dimBlock.y)
+	*/
+
+	{
+		std::lock_guard<std::mutex> _lock(mutex);
+		this->devRead = devRead;
+		this->devWrite = devWrite;
+		this->width = width;
+		this->height = height;
+		this->blockX = blockX;
+		this->blockY = blockY;
+		gridX = (width + blockX - 1) / blockX;
+		numBlocks = gridX * ((height + blockY - 1) / blockY);
+		nextBlock = 0;
+		busyWorkers = (int)workers.size();
+		launch++;
+	}
+	start.notify_all();
+
+	// The calling thread takes blocks as well
+	RunBlocks();
+	std::unique_lock<std::mutex> _lock(mutex);
+	done.wait(_lock, [&] { return busyWorkers == 0; });
+}
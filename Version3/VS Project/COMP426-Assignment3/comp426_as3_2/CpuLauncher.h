@@ -0,0 +1,52 @@
+#ifndef CPU_LAUNCHER_H
+#define CPU_LAUNCHER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class CpuLauncher
+{
+	/**
+	@Desc : Runs updateKernel on the CPU. The grid of blocks of the CUDA launch is handed out block by block
+	to a pool of threads, and each block runs its threads one after the other (the kernel does not
+	synchronise within a block, so the order does not matter)
+	*/
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	// Workers wait for a new launch on start, the caller waits for the last block on done
+	std::condition_variable start;
+	std::condition_variable done;
+	// Launch in progress, incremented for every launch so workers notice a new one
+	int launch;
+	bool stopping;
+	const int *devRead;
+	int *devWrite;
+	int width;
+	int height;
+	int blockX;
+	int blockY;
+	int gridX;
+	int numBlocks;
+	// Next block to hand out
+	std::atomic<int> nextBlock;
+	// Workers that have not finished the current launch yet
+	int busyWorkers;
+
+	CpuLauncher(const CpuLauncher &);
+	CpuLauncher &operator=(const CpuLauncher &);
+
+	void Worker();
+	void RunBlocks();
+
+public:
+	CpuLauncher(int threads = 0);
+	~CpuLauncher();
+
+	void Launch(const int *devRead, int *devWrite, int width, int height, int blockX, int blockY);
+};
+
+#endif
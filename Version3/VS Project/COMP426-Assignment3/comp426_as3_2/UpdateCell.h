@@ -0,0 +1,87 @@
+#ifndef UPDATE_CELL_H
+#define UPDATE_CELL_H
+
+// The cell rule is compiled by nvcc for updateKernel and by a plain C++ compiler for the CPU launcher
+#ifdef __CUDACC__
+#define HOST_DEVICE __host__ __device__
+#else
+#define HOST_DEVICE
+#endif
+
+// Define states for cells
+#define HEALTHY  0
+#define CANCER   1
+#define MEDICINE 2
+
+HOST_DEVICE inline void UpdateCell(const int *devRead, int *devWrite, int x, int y, int width, int height)
+{
+	/**
+	@Desc : Updates one cell state (the body of updateKernel). Only cells that change are written,
+	devWrite has to hold a copy of devRead beforehand
+	@param1 : pointer to read array
+	@param2 : pointer to write array
+	@param3 : x position of current cell
+	@param4 : y position of current cell
+	@param5 : width of the grid
+	@param6 : height of the grid
+	*/
+
+	if (devRead[x*height + y] == HEALTHY || devRead[x*height + y] == CANCER) {
+		int _numSurrounded = 0;
+		int _before = 0;
+		int _after = 0;
+
+		// If a healthy cell is surrounded by >= 6 cancer cells,
+		// it becomes a cancer cell
+		if (devRead[x*height + y] == HEALTHY) {
+			_before = CANCER;
+			_after = CANCER;
+		}
+		// If a cancer cell is surrounded by >= 6 medicine cells,
+		// it becomes a healthy cell
+		else if (devRead[x*height + y] == CANCER) {
+			_before = MEDICINE;
+			_after = HEALTHY;
+		}
+
+		// Check the states of the surrounding cells
+		if (x > 0 && y > 0) {
+			if (devRead[(x - 1)*height + (y - 1)] == _before)
+				_numSurrounded++;
+		}
+		if (y > 0) {
+			if (devRead[x*height + (y - 1)] == _before)
+				_numSurrounded++;
+		}
+		if (x < (width - 1) && y > 0) {
+			if (devRead[(x + 1)*height + (y - 1)] == _before)
+				_numSurrounded++;
+		}
+		if (x > 0) {
+			if (devRead[(x - 1)*height + y] == _before)
+				_numSurrounded++;
+		}
+		if (x < (width - 1)) {
+			if (devRead[(x + 1)*height + y] == _before)
+				_numSurrounded++;
+		}
+		if (x > 0 && y < (height - 1)) {
+			if (devRead[(x - 1)*height + (y + 1)] == _before)
+				_numSurrounded++;
+		}
+		if (y < (height - 1)) {
+			if (devRead[x*height + (y + 1)] == _before)
+				_numSurrounded++;
+		}
+		if (x < (width - 1) && y < (height - 1)) {
+			if (devRead[(x + 1)*height + (y + 1)] == _before)
+				_numSurrounded++;
+		}
+		// Change state if surrounded by >= 6 of a certain cell
+		if (_numSurrounded >= 6) {
+			devWrite[x*height + y] = _after;
+		}
+	}
+}
+
+#endif
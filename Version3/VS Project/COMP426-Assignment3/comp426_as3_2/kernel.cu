@@ -1,10 +1,14 @@
 
 #include "cuda_runtime.h"
 #include "device_launch_parameters.h"
+#include "UpdateCell.h"
+#include "CpuLauncher.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
 #include <string>
+#include <chrono>
 
 // OpenGL Graphics includes
 #include "GL/glew.h"
@@ -14,10 +18,7 @@
 #include "GL/freeglut.h" 
 #endif
 
-// Define states for cells
-#define HEALTHY  0
-#define CANCER   1
-#define MEDICINE 2
+#include "FramePacer.h"
 
 // 2D area of 1024 x 768 cells
 const int g_windowWidth = 1024;
@@ -25,6 +26,14 @@ const int g_windowHeight = 768;
 int g_quad_read[g_windowWidth][g_windowHeight];
 int g_quad_write[g_windowWidth][g_windowHeight];
 
+// Each CUDA block updates 16 x 32 cells
+const int g_blockX = 16;
+const int g_blockY = 32;
+
+// With --cpu, updateKernel runs on the CPU through g_cpuLauncher and no CUDA device is needed
+bool g_useCpu = false;
+CpuLauncher *g_cpuLauncher = NULL;
+
 // Update every 1/30th second
 const int g_updateTime = 1.0 / 30.0 * 1000.0;
 
@@ -33,6 +42,10 @@ const int g_initialCancer = g_windowWidth * g_windowHeight * 0.26;
 
 const int g_font = (int)GLUT_BITMAP_TIMES_ROMAN_24;
 
+// Frames are only drawn when a new generation or an input event arrives, at most once per monitor refresh.
+// The pacer also prints the throughput and CPU usage every few seconds
+FramePacer g_pacer;
+
 cudaError_t updateWithCuda();
 
 __global__ void updateKernel(int *devRead, int *devWrite)
@@ -46,62 +59,8 @@ __global__ void updateKernel(int *devRead, int *devWrite)
 	int x = blockDim.x * blockIdx.x + threadIdx.x;
 	int y = blockDim.y * blockIdx.y + threadIdx.y;
 
-	if (devRead[x*g_windowHeight + y] == HEALTHY || devRead[x*g_windowHeight + y] == CANCER) {
-		int _numSurrounded = 0;
-		int _before = 0;
-		int _after = 0;
-
-		// If a healthy cell is surrounded by >= 6 cancer cells,
-		// it becomes a cancer cell
-		if (devRead[x*g_windowHeight + y] == HEALTHY) {
-			_before = CANCER;
-			_after = CANCER;
-		}
-		// If a cancer cell is surrounded by >= 6 medicine cells,
-		// it becomes a healthy cell
-		else if (devRead[x*g_windowHeight + y] == CANCER) {
-			_before = MEDICINE;
-			_after = HEALTHY;
-		}
-
-		// Check the states of the surrounding cells
-		if (x > 0 && y > 0) {
-			if (devRead[(x - 1)*g_windowHeight + (y - 1)] == _before)
-				_numSurrounded++;
-		}
-		if (y > 0) {
-			if (devRead[x*g_windowHeight + (y - 1)] == _before)
-				_numSurrounded++;
-		}
-		if (x < (g_windowWidth - 1) && y > 0) {
-			if (devRead[(x + 1)*g_windowHeight + (y - 1)] == _before)
-				_numSurrounded++;
-		}
-		if (x > 0) {
-			if (devRead[(x - 1)*g_windowHeight + y] == _before)
-				_numSurrounded++;
-		}
-		if (x < (g_windowWidth - 1)) {
-			if (devRead[(x + 1)*g_windowHeight + y] == _before)
-				_numSurrounded++;
-		}
-		if (x > 0 && y < (g_windowHeight - 1)) {
-			if (devRead[(x - 1)*g_windowHeight + (y + 1)] == _before)
-				_numSurrounded++;
-		}
-		if (y < (g_windowHeight - 1)) {
-			if (devRead[x*g_windowHeight + (y + 1)] == _before)
-				_numSurrounded++;
-		}
-		if (x < (g_windowWidth - 1) && y < (g_windowHeight - 1)) {
-			if (devRead[(x + 1)*g_windowHeight + (y + 1)] == _before)
-				_numSurrounded++;
-		}
-		// Change state if surrounded by >= 6 of a certain cell
-		if (_numSurrounded >= 6) {
-			devWrite[x*g_windowHeight + y] = _after;
-		}
-	}
+	// The rule itself is shared with the CPU launcher (see UpdateCell.h)
+	UpdateCell(devRead, devWrite, x, y, g_windowWidth, g_windowHeight);
 }
 
 cudaError_t updateWithCuda()
@@ -147,7 +106,7 @@ cudaError_t updateWithCuda()
         goto Error;
     }
 
-	dim3 dimBlock(16, 32);
+	dim3 dimBlock(g_blockX, g_blockY);
 	dim3 dimGrid;
 	dimGrid.x = (1024 + dimBlock.x - 1) / dimBlock.x;
 	dimGrid.y = (768 + dimBlock.y - 1) / dimBlock.y;
@@ -184,11 +143,11 @@ Error:
     return cudaStatus;
 }
 
-void Update(int value)
+bool Step()
 {
 	/**
-	@Desc : Function that uses CUDA to update the cells in parallal, and then calls itself (to update again)
-	@param1 : unused parameter that is passed by the glutTimerFunc
+	@Desc : Runs one generation with CUDA, or with the CPU launcher when --cpu is given
+	@return : false if CUDA failed
 	*/
 
 	// Update read array with current data from write array before each new update
@@ -198,12 +157,17 @@ void Update(int value)
 		}
 	}
 
+	if (g_useCpu) {
+		g_cpuLauncher->Launch(&g_quad_read[0][0], &g_quad_write[0][0], g_windowWidth, g_windowHeight, g_blockX, g_blockY);
+		return true;
+	}
+
 	// Update cells in parallel
     cudaError_t cudaStatus = updateWithCuda();
 
 	if (cudaStatus != cudaSuccess) {
         fprintf(stderr, "updateWithCuda failed!");
-        return;
+        return false;
     }
 
     // cudaDeviceReset must be called before exiting in order for profiling and
@@ -211,10 +175,55 @@ void Update(int value)
     cudaStatus = cudaDeviceReset();
     if (cudaStatus != cudaSuccess) {
         fprintf(stderr, "cudaDeviceReset failed!");
-        return;
+        return false;
     }
+	return true;
+}
 
-	glutPostRedisplay();
+int RunHeadless(int generations)
+{
+	/**
+	@Desc : Runs generations without opening a window, then prints the throughput and a checksum of the grid
+	so runs of the CUDA and the CPU path (with the same --seed) can be compared
+	@param1 : number of generations to run
+	@return : process exit code
+	*/
+
+	auto _start = std::chrono::steady_clock::now();
+	for (int g = 0; g < generations; g++) {
+		if (!Step())
+			return 1;
+	}
+	double _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+
+	// 64-bit FNV-1a over the cells
+	unsigned long long _hash = 14695981039346656037ULL;
+	for (int i = 0; i < g_windowWidth; i++) {
+		for (int j = 0; j < g_windowHeight; j++) {
+			_hash ^= (unsigned long long)g_quad_write[i][j];
+			_hash *= 1099511628211ULL;
+		}
+	}
+	printf("%s: %d generations in %.3f s (%.1f generations/s), grid checksum %016llx\n", g_useCpu ? "CPU" : "CUDA",
+		generations, _seconds, generations / _seconds, _hash);
+	return 0;
+}
+
+void Update(int value)
+{
+	/**
+	@Desc : Function that uses CUDA to update the cells in parallal, and then calls itself (to update again)
+	@param1 : unused parameter that is passed by the glutTimerFunc
+	*/
+
+	if (!Step())
+		return;
+
+	g_pacer.GenerationsDone(1);
+	if (g_pacer.ReportDue())
+		g_pacer.Report("");
+
+	g_pacer.RequestRedisplay();
 	glutTimerFunc(g_updateTime, Update, 0);
 }
 
@@ -241,6 +250,8 @@ void Display()
 	@Desc : Displays the cells and text in a window on screen
 	*/
 
+	g_pacer.FrameDrawn();
+
 	// Display the cells using OpenGL
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glLoadIdentity();
@@ -363,6 +374,20 @@ void MouseClicks(int button, int state, int x, int y)
 	}
 }
 
+void SetPacer(bool enabled)
+{
+	/**
+	@Desc : Switches between drawing on change and redrawing continuously from the idle function
+	@param1 : true to only draw when something changed
+	*/
+
+	g_pacer.SetEnabled(enabled);
+	glutIdleFunc(enabled ? NULL : Display);
+	// Each report only covers one mode
+	g_pacer.ResetStats();
+	glutPostRedisplay();
+}
+
 void Keyboard(unsigned char key, int mousePositionX, int mousePositionY)
 {
 	/**
@@ -379,22 +404,78 @@ void Keyboard(unsigned char key, int mousePositionX, int mousePositionY)
 		exit ( 0 );
 		break;
 
+	// Toggle the frame pacer
+	case 'p':
+		SetPacer(!g_pacer.Enabled());
+		break;
+
 	default:
 		break;
 	}
 }
 
+bool ParseNumber(const std::string &text, unsigned long maximum, unsigned long &value)
+{
+	/**
+	@Desc : Reads a command line value made of decimal digits only
+	@param1 : text of the value
+	@param2 : largest accepted value
+	@param3 : receives the value
+	@return : false if the text is empty, holds anything but digits or is larger than maximum
+	*/
+
+	if (text.empty() || text.size() > 10 || text.find_first_not_of("0123456789") != std::string::npos)
+		return false;
+	unsigned long long _value = strtoull(text.c_str(), NULL, 10);
+	if (_value > maximum)
+		return false;
+	value = (unsigned long)_value;
+	return true;
+}
+
 int main(int argc, char **argv)
 {
 	/**
 	@Desc : Main control thread
 	*/
 
-	// initialize
-	glutInit(&argc, argv);
-	glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH );
-	glutInitWindowSize(g_windowWidth, g_windowHeight);
-	glutCreateWindow("2D Cell Growth Simulation");
+	// Parse the command line options (GLUT ignores the ones it does not know)
+	int _headless = 0;
+	unsigned int _seed = (unsigned int)time(NULL);
+	g_pacer.SetInterval(1000 / MonitorRefreshRate());
+	for (int i = 1; i < argc; i++) {
+		std::string _arg = argv[i];
+		if (_arg == "--no-pacer")
+			g_pacer.SetEnabled(false);
+		else if (_arg.compare(0, 10, "--refresh=") == 0) {
+			int _interval;
+			if (!FrameIntervalFromRate(_arg.substr(10), _interval)) {
+				printf("Error: --refresh= expects a refresh rate in Hz above 0!\n");
+				return 1;
+			}
+			g_pacer.SetInterval(_interval);
+		}
+		else if (_arg == "--cpu")
+			g_useCpu = true;
+		else if (_arg.compare(0, 11, "--headless=") == 0) {
+			unsigned long _generations;
+			if (!ParseNumber(_arg.substr(11), 0x7FFFFFFFUL, _generations)) {
+				printf("Error: --headless= expects a number of generations!\n");
+				return 1;
+			}
+			_headless = (int)_generations;
+		}
+		else if (_arg.compare(0, 7, "--seed=") == 0) {
+			unsigned long _value;
+			if (!ParseNumber(_arg.substr(7), 0xFFFFFFFFUL, _value)) {
+				printf("Error: --seed= expects a number from 0 to 4294967295!\n");
+				return 1;
+			}
+			_seed = (unsigned int)_value;
+		}
+	}
+	if (g_useCpu)
+		g_cpuLauncher = new CpuLauncher();
 
 	// Initialize all cells as healthy cells
 	for (int i = 0; i < 1024; i++)
@@ -406,7 +487,7 @@ int main(int argc, char **argv)
 	}
 
 	// Initialize random seed
-	srand(time(NULL));
+	srand(_seed);
 
 	// Change at least 25% of cells to cancer cells
 	for (int i = 0; i <= g_initialCancer; i++)
@@ -419,13 +500,26 @@ int main(int argc, char **argv)
 			g_quad_write[x][y] = CANCER;
 	}
 
+	// Runs without a window, for benchmarking and for comparing the CPU launcher with CUDA
+	if (_headless > 0)
+		return RunHeadless(_headless);
+
+	// initialize
+	glutInit(&argc, argv);
+	glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH );
+	glutInitWindowSize(g_windowWidth, g_windowHeight);
+	glutCreateWindow("2D Cell Growth Simulation");
+
 	glutDisplayFunc(Display);
-	glutIdleFunc(Display);
+	// Redraws are requested by RequestRedisplay, the idle function is only used with the pacer off
+	if (!g_pacer.Enabled())
+		glutIdleFunc(Display);
 	glutMouseFunc(MouseClicks);
 	glutKeyboardFunc(Keyboard);
 	glutTimerFunc(g_updateTime, Update, 0);
 	Initialize();
 
+	g_pacer.ResetStats();
 	glutMainLoop();
 	return 0;
 }
\ No newline at end of file
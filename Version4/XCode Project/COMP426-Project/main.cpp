@@ -2,6 +2,10 @@
 #include <stdio.h>
 #include <time.h>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <math.h>
@@ -9,27 +13,57 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#ifdef __APPLE__
 // OpenGL Graphics include
 #include <GLUT/glut.h>
 // OpenCL include
 #include <OpenCL/opencl.h>
+#else
+// Other platforms (e.g. Linux with PoCL) use the Khronos header names
+#include <GL/glut.h>
+#include <CL/cl.h>
+#endif
+
+#include "FramePacer.h"
 
 // Define states for cells
 enum cell {CANCER, HEALTHY, MEDICINE};
 
-// 2D area of 1024 x 768 cells
-const int g_windowWidth = 1024;
-const int g_windowHeight = 768;
-cell g_quad[g_windowWidth][g_windowHeight];
+// 2D area of 1024 x 768 cells by default (--size=<width>x<height>), the window opens at the same size up to 1024 x 768
+int g_windowWidth = 1024;
+int g_windowHeight = 768;
+// Each cell takes one byte (a value of enum cell), on the host and on the device. Stored column by column (see Cell)
+std::vector<cl_uchar> g_quad;
+// Cells the host reads and writes: g_quad, or the mapped device grid in zero-copy mode (see MapLatest)
+cl_uchar *g_cells = NULL;
+
+// A cell changes state when surrounded by at least this many cells of the other kind (--threshold=N)
+int g_threshold = 6;
 
 // Update every 1/30th second
 const int g_updateTime = 1.0 / 30.0 * 1000.0;
 
 // At least 25% of cells initialized as cancer cells
-const int g_initialCancer = g_windowWidth * g_windowHeight * 0.26;
+int g_initialCancer = 0;
+
+inline cl_uchar &Cell(int x, int y)
+{
+    /**
+     @Desc : Returns the cell at (x, y) of the host grid
+     */
+
+    return g_cells[x * g_windowHeight + y];
+}
 
 void * g_font = GLUT_BITMAP_TIMES_ROMAN_24;
 
+// Frames are only drawn when a new generation or an input event arrives, at most once per monitor refresh.
+// The pacer also prints the throughput and CPU usage every few seconds
+FramePacer g_pacer;
+
+// Device type to run the simulation on (falls back to any available device, so a CPU-only OpenCL such as PoCL works)
+cl_device_type g_deviceType = CL_DEVICE_TYPE_GPU;
+
 // GPU compute device id
 cl_device_id gpu_device_id;
 // GPU compute context
@@ -40,6 +74,10 @@ cl_command_queue gpu_commands;
 cl_program gpu_program;
 // GPU compute kernel
 cl_kernel gpu_kernel;
+// GPU compute kernel that stages tiles of the grid in local memory
+cl_kernel gpu_tiled_kernel;
+// GPU compute kernel that updates 16 cells per work item with vector loads and stores
+cl_kernel gpu_vector_kernel;
 
 // CPU compute device id
 cl_device_id cpu_device_id;
@@ -52,53 +90,196 @@ cl_program cpu_program;
 // GPU compute kernel
 cl_kernel cpu_kernel;
 
+// Split the grid between the GPU and the CPU device (--hetero). The GPU updates the rows above g_split and the CPU
+// the rows from g_split down. Each device keeps a whole grid, the rows on either side of the split are exchanged
+// after every generation
+bool g_heterogeneous = false;
+// Grid buffers of the CPU device, they ping-pong together with g_deviceQuad
+cl_mem g_cpuQuad[2];
+int g_split = 0;
+// Bands never get thinner than this, so both devices keep some work to time
+const int g_minBand = 16;
+// Kernel time of each band is summed over a few generations before the split is moved
+const int g_balanceInterval = 8;
+int g_balanceGenerations = 0;
+double g_gpuBandSeconds = 0.0;
+double g_cpuBandSeconds = 0.0;
+
 // Error code returned from api calls
 int err;
 
-// Device memory used for the input array
-cl_mem readQuad;
-// Device memory used for the output array
-cl_mem writeQuad;
+// Compiled programs are kept in this directory (under $HOME) and loaded instead of being built again on the
+// next launch. --no-program-cache always builds from source
+const char *g_programCacheDir = ".cache/COMP426-Project";
+bool g_programCache = true;
+
+// The grid stays resident in device memory. Each generation reads one buffer and writes the other,
+// then the two swap roles, so the grid only crosses the bus when the host changes it
+cl_mem g_deviceQuad[2];
+// Index of the device buffer holding the latest generation
+int g_current = 0;
+// Set when g_quad was filled on the host and has to be uploaded (injections are applied on the device instead)
+bool g_uploadPending = true;
+// Set when the device is ahead of g_quad. The grid is only read back when someone looks at it
+bool g_readbackPending = false;
+
+// Injections made since the last update, as (x, y, type) triples. They are applied to the resident grid by
+// the Inject kernel, so a click costs a few bytes instead of a grid upload
+std::vector<cl_int> g_injections;
+// Injections sent to the device per Inject kernel (the size of the injection buffers)
+const int g_maxInjections = 256;
+cl_kernel gpu_inject_kernel;
+cl_kernel cpu_inject_kernel;
+cl_mem g_injectionBuffer;
+cl_mem g_cpuInjectionBuffer;
+
+// Population of each state after the latest generation, indexed by state. The last kernel of every batch
+// counts the states it writes into a counts buffer, so the totals cost a 12 byte read instead of the grid
+cl_int g_population[3];
+// Counts of the CPU band in heterogeneous mode (added to g_population once read)
+cl_int g_cpuPopulation[3];
+cl_mem g_countsBuffer;
+cl_mem g_cpuCountsBuffer;
+// Reads of the counts still in flight (see Population)
+std::vector<cl_event> g_countReads;
+
+// The heal cascade of the CPU versions (--cascade): after each generation, medicine cells connected through medicine
+// to a cancer cell that turned healthy turn healthy too. Rounds of HealCascade run until the changed flag stays clear
+bool g_cascade = false;
+cl_kernel gpu_cascade_kernel;
+cl_mem g_changedBuffer;
+// Cleared once the counts show no medicine left (and no injection is queued), the cascade has nothing to heal then
+bool g_medicinePresent = false;
+
+// When the device shares memory with the host (CPU devices, integrated GPUs), the grid buffers are allocated in
+// host-accessible memory and the latest generation is mapped rather than copied (--no-zero-copy turns this off)
+bool g_zeroCopy = true;
+// Device grid that is currently mapped (NULL when none) and the event of its map command (NULL once ReadBack took it)
+cl_mem g_mappedQuad = NULL;
+cl_event g_mapEvent = NULL;
 
-// Device memory used for the input display array
-cl_mem colorQuad;
+// Number of generations enqueued back to back per update (--batch=K), or chosen from the frame budget (--batch=auto)
+int g_batchSize = 1;
+bool g_adaptiveBatch = false;
+const int g_maxBatch = 256;
+// Share of the update interval the device may spend on one batch when the batch size is adaptive
+const double g_batchBudget = 0.5;
+// Device time per generation measured on the last completed batch (written by the OpenCL event callback)
+std::atomic<double> g_secondsPerGeneration(0.0);
+
+struct Batch
+{
+    std::chrono::steady_clock::time_point start;
+    int generations;
+};
+
+// Every upload, kernel, readback and halo copy is timed with OpenCL event profiling, and the time the host spends
+// blocked waiting for the device is timed on the host. Each phase keeps its most recent samples
+enum Phase {UPLOAD_PHASE, INJECT_PHASE, KERNEL_PHASE, CASCADE_PHASE, COUNTS_PHASE, READBACK_PHASE, HALO_PHASE, WAIT_PHASE, NUM_PHASES};
+const char *g_phaseNames[NUM_PHASES] = {"upload", "inject", "kernel", "cascade", "counts", "readback", "halo", "host wait"};
+const size_t g_phaseWindow = 1000;
+
+struct PhaseStats
+{
+    // Milliseconds, used as a ring buffer once it holds g_phaseWindow samples
+    std::vector<double> samples;
+    size_t next;
+    long long count;
+};
+PhaseStats g_phases[NUM_PHASES];
+
+// Events whose profiling info is read once they complete (see CollectEvents)
+struct PendingEvent
+{
+    cl_event event;
+    Phase phase;
+};
+std::vector<PendingEvent> g_pendingEvents;
+
+// The summary of every phase is written to this file on exit (--profile-csv=<path>)
+std::string g_profileCsv = "opencl_profile.csv";
 
 // Global domain size for our calculation
 size_t global;
 // Local domain size for our calculation
 size_t local;
 
-int g_totalSize = (g_windowWidth*g_windowHeight);
+// Update kernel to run (--kernel=naive|tiled|vector)
+enum KernelType {NAIVE_KERNEL, TILED_KERNEL, VECTOR_KERNEL};
+KernelType g_kernelType = NAIVE_KERNEL;
+// Work group shape of the tiled kernel, dimension 0 runs along y (contiguous in memory) and dimension 1 along x.
+// Set with --workgroup=<cells along x>x<cells along y>
+size_t g_workGroup[2] = {16, 16};
+
+int g_totalSize = 0;
 
 const char *KernelGPUSource = "\n\
-__kernel void UpdateWithGPU(__global int* readQuad, __global int* writeQuad)\n\
+// The grid size, rule and states come from the host as build options (see KernelOptions)\n\
+#if !defined(WIDTH) || !defined(HEIGHT) || !defined(THRESH) || !defined(CANCER) || !defined(HEALTHY) || !defined(MEDICINE)\n\
+#error Build with -DWIDTH=... -DHEIGHT=... -DTHRESH=... -DCANCER=... -DHEALTHY=... -DMEDICINE=...\n\
+#endif\n\
+// Type of a cell in device memory, the benchmark also builds the kernels with -DCELL=int\n\
+#ifndef CELL\n\
+#define CELL uchar\n\
+#endif\n\
+\n\
+// Adds the new states of a work group to the population counts (indexed by state): a histogram in local memory,\n\
+// then one atomic per state. Every work item of the group must call it, with zeros if it updated no cell\n\
+void CountPopulation(__local int* histogram, __global int* counts, int cancer, int healthy, int medicine)\n\
+{\n\
+    int _id = get_local_id(1) * get_local_size(0) + get_local_id(0);\n\
+    int _size = get_local_size(0) * get_local_size(1);\n\
+    for (int i = _id; i < 3; i += _size)\n\
+        histogram[i] = 0;\n\
+    barrier(CLK_LOCAL_MEM_FENCE);\n\
+    if (cancer)\n\
+        atomic_add(&histogram[CANCER], cancer);\n\
+    if (healthy)\n\
+        atomic_add(&histogram[HEALTHY], healthy);\n\
+    if (medicine)\n\
+        atomic_add(&histogram[MEDICINE], medicine);\n\
+    barrier(CLK_LOCAL_MEM_FENCE);\n\
+    for (int i = _id; i < 3; i += _size) {\n\
+        if (histogram[i])\n\
+            atomic_add(&counts[i], histogram[i]);\n\
+    }\n\
+}\n\
+\n\
+// Number of lanes of a vector comparison that held (they are -1, the others 0)\n\
+int CountLanes(char16 lanes)\n\
+{\n\
+    return -(lanes.s0 + lanes.s1 + lanes.s2 + lanes.s3 + lanes.s4 + lanes.s5 + lanes.s6 + lanes.s7 +\n\
+        lanes.s8 + lanes.s9 + lanes.sa + lanes.sb + lanes.sc + lanes.sd + lanes.se + lanes.sf);\n\
+}\n\
+\n\
+__kernel void UpdateWithGPU(__global CELL* readQuad, __global CELL* writeQuad, __global int* counts)\n\
 {\n\
     /**\n\
     @Desc : Updates each cell state using GPU kernel\n\
     @param1 : pointer to read array\n\
-    @param2 : pointer to write array\n\
+    @param2 : pointer to write array (every cell is written, unchanged cells included)\n\
+    @param3 : population counts to add the new states to (NULL to skip counting)\n\
     */\n\
-    int width = 1024;\n\
-    int height = 768;\n\
+    __local int _histogram[3];\n\
+    int width = WIDTH;\n\
+    int height = HEIGHT;\n\
     int i = get_global_id(0);\n\
     int x = i / height;\n\
     int y = i % height;\n\
-    int CANCER = 0;\n\
-    int HEALTHY = 1;\n\
-    int MEDICINE = 2;\n\
-    if (readQuad[x*height + y] == HEALTHY || readQuad[x*height + y] == CANCER) {\n\
+    int _state = readQuad[x*height + y];\n\
+    if (_state == HEALTHY || _state == CANCER) {\n\
         int _numSurrounded = 0;\n\
         int _before = 0;\n\
         int _after = 0;\n\
-        // If a healthy cell is surrounded by >= 6 cancer cells,\n\
+        // If a healthy cell is surrounded by >= THRESH cancer cells,\n\
         // it becomes a cancer cell\n\
-        if (readQuad[x*height + y] == HEALTHY) {\n\
+        if (_state == HEALTHY) {\n\
             _before = CANCER;\n\
             _after = CANCER;\n\
         }\n\
-        // If a cancer cell is surrounded by >= 6 medicine cells,\n\
+        // If a cancer cell is surrounded by >= THRESH medicine cells,\n\
         // it becomes a healthy cell\n\
-        else if (readQuad[x*height + y] == CANCER) {\n\
+        else if (_state == CANCER) {\n\
             _before = MEDICINE;\n\
             _after = HEALTHY;\n\
         }\n\
@@ -135,478 +316,2166 @@ __kernel void UpdateWithGPU(__global int* readQuad, __global int* writeQuad)\n\
             if (readQuad[(x + 1)*height + (y + 1)] == _before)\n\
                 _numSurrounded++;\n\
         }\n\
-        // Change state if surrounded by >= 6 of a certain cell\n\
-        if (_numSurrounded >= 6) {\n\
-            writeQuad[x*height + y] = _after;\n\
+        // Change state if surrounded by >= THRESH of a certain cell\n\
+        if (_numSurrounded >= THRESH) {\n\
+            _state = _after;\n\
+        }\n\
+    }\n\
+    writeQuad[x*height + y] = _state;\n\
+    if (counts)\n\
+        CountPopulation(_histogram, counts, _state == CANCER, _state == HEALTHY, _state == MEDICINE);\n\
+}\n\
+\n\
+__kernel void UpdateWithGPUTiled(__global const CELL* readQuad, __global CELL* writeQuad, __local CELL* tile, int rows,\n\
+    __global int* counts)\n\
+{\n\
+    /**\n\
+    @Desc : Updates each cell state using GPU kernel, with a 2D range and the neighbourhood of the work group\n\
+    staged in local memory so each cell is read from global memory about once\n\
+    @param1 : pointer to read array\n\
+    @param2 : pointer to write array (every cell is written, unchanged cells included)\n\
+    @param3 : local memory for (work group width + 2) x (work group height + 2) cells\n\
+    @param4 : number of rows to update from the top (fewer than height when the CPU updates the rest)\n\
+    @param5 : population counts to add the new states to (NULL to skip counting)\n\
+    */\n\
+    __local int _histogram[3];\n\
+    int width = WIDTH;\n\
+    int height = HEIGHT;\n\
+    int y = get_global_id(0);\n\
+    int x = get_global_id(1);\n\
+    int localY = get_local_id(0);\n\
+    int localX = get_local_id(1);\n\
+    int groupHeight = get_local_size(0);\n\
+    int groupWidth = get_local_size(1);\n\
+    int tileHeight = groupHeight + 2;\n\
+    int tileWidth = groupWidth + 2;\n\
+    // Top left corner of the tile, one cell outside the work group\n\
+    int tileX = get_group_id(1) * groupWidth - 1;\n\
+    int tileY = get_group_id(0) * groupHeight - 1;\n\
+    // Load the tile and its halo together, neighbouring work items read neighbouring y.\n\
+    // Cells outside the grid are loaded as -1, which matches no state, so the stencil needs no bounds checks\n\
+    for (int i = localX * groupHeight + localY; i < tileWidth * tileHeight; i += groupWidth * groupHeight) {\n\
+        int gx = tileX + i / tileHeight;\n\
+        int gy = tileY + i % tileHeight;\n\
+        tile[i] = (gx >= 0 && gx < width && gy >= 0 && gy < height) ? readQuad[gx*height + gy] : -1;\n\
+    }\n\
+    barrier(CLK_LOCAL_MEM_FENCE);\n\
+    // The range is rounded up to whole work groups, the work items outside the grid only take part in the count\n\
+    int _state = -1;\n\
+    if (x < width && y < rows) {\n\
+        int c = (localX + 1) * tileHeight + (localY + 1);\n\
+        _state = tile[c];\n\
+        if (_state == HEALTHY || _state == CANCER) {\n\
+            // Healthy cells count cancer neighbours, cancer cells count medicine neighbours\n\
+            int _before = (_state == HEALTHY) ? CANCER : MEDICINE;\n\
+            int _numSurrounded = (tile[c - tileHeight - 1] == _before) + (tile[c - 1] == _before) + (tile[c + tileHeight - 1] == _before) +\n\
+                (tile[c - tileHeight] == _before) + (tile[c + tileHeight] == _before) +\n\
+                (tile[c - tileHeight + 1] == _before) + (tile[c + 1] == _before) + (tile[c + tileHeight + 1] == _before);\n\
+            // Change state if surrounded by >= THRESH of a certain cell\n\
+            if (_numSurrounded >= THRESH)\n\
+                _state = (_state == HEALTHY) ? CANCER : HEALTHY;\n\
+        }\n\
+        writeQuad[x*height + y] = _state;\n\
+    }\n\
+    if (counts)\n\
+        CountPopulation(_histogram, counts, _state == CANCER, _state == HEALTHY, _state == MEDICINE);\n\
+}\n\
+\n\
+__kernel void UpdateWithGPUVector(__global const uchar* readQuad, __global uchar* writeQuad, __global int* counts)\n\
+{\n\
+    /**\n\
+    @Desc : Updates a run of 16 cells of one column per work item using GPU kernel, with uchar16 loads and stores.\n\
+    Dimension 0 of the range runs along y in steps of 16 cells, dimension 1 along x\n\
+    @param1 : pointer to read array\n\
+    @param2 : pointer to write array\n\
+    @param3 : population counts to add the new states to (NULL to skip counting)\n\
+    */\n\
+    __local int _histogram[3];\n\
+    int width = WIDTH;\n\
+    int height = HEIGHT;\n\
+    int y = get_global_id(0) * 16;\n\
+    int x = get_global_id(1);\n\
+    // Masks that shift a run down or up by one cell, shifting in the cell just outside the run\n\
+    uchar16 _shiftDown = (uchar16)(16, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14);\n\
+    uchar16 _shiftUp = (uchar16)(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16);\n\
+    uchar16 _state = vload16(0, readQuad + x*height + y);\n\
+    // Healthy cells count cancer neighbours, cancer cells count medicine neighbours\n\
+    uchar16 _before = select((uchar16)(MEDICINE), (uchar16)(CANCER), _state == (uchar16)(HEALTHY));\n\
+    char16 _numSurrounded = (char16)(0);\n\
+    for (int nx = x - 1; nx <= x + 1; nx++) {\n\
+        // Columns outside the grid have no neighbours to count\n\
+        if (nx < 0 || nx >= width)\n\
+            continue;\n\
+        uchar16 _run = vload16(0, readQuad + nx*height + y);\n\
+        uchar _above = (y > 0) ? readQuad[nx*height + y - 1] : 255;\n\
+        uchar _below = (y + 16 < height) ? readQuad[nx*height + y + 16] : 255;\n\
+        // A vector comparison gives -1 in every lane where it holds\n\
+        _numSurrounded -= shuffle2(_run, (uchar16)(_above), _shiftDown) == _before;\n\
+        _numSurrounded -= shuffle2(_run, (uchar16)(_below), _shiftUp) == _before;\n\
+        if (nx != x)\n\
+            _numSurrounded -= _run == _before;\n\
+    }\n\
+    // Change state if surrounded by >= THRESH of a certain cell (medicine cells never change)\n\
+    char16 _change = (_numSurrounded >= (char16)(THRESH)) & (_state != (uchar16)(MEDICINE));\n\
+    uchar16 _after = select((uchar16)(HEALTHY), (uchar16)(CANCER), _state == (uchar16)(HEALTHY));\n\
+    _state = select(_state, _after, _change);\n\
+    vstore16(_state, 0, writeQuad + x*height + y);\n\
+    if (counts)\n\
+        CountPopulation(_histogram, counts, CountLanes(_state == (uchar16)(CANCER)), CountLanes(_state == (uchar16)(HEALTHY)),\n\
+            CountLanes(_state == (uchar16)(MEDICINE)));\n\
+}\n\
+\n\
+__kernel void HealCascade(__global const CELL* readQuad, __global CELL* writeQuad, __local CELL* tile, __global int* changed,\n\
+    __global int* counts)\n\
+{\n\
+    /**\n\
+    @Desc : One round of the heal cascade. When a cancer cell turns healthy, the medicine cells 8-connected to it\n\
+    through medicine cells turn healthy too. A healing cell is one written HEALTHY that was not HEALTHY before\n\
+    (a healed cancer or medicine cell). Healing spreads through the tile of the work group in local memory until\n\
+    it settles, and changed is set when a cell on the edge of the group healed, so another round carries it on\n\
+    into the neighbouring groups\n\
+    @param1 : pointer to the grid before the generation\n\
+    @param2 : pointer to the grid after the generation (healed cells are written in place)\n\
+    @param3 : local memory for (work group width + 2) x (work group height + 2) cells\n\
+    @param4 : flag set when another round is needed\n\
+    @param5 : population counts to move the healed cells to (NULL to skip counting)\n\
+    */\n\
+    __local int _spreading;\n\
+    int width = WIDTH;\n\
+    int height = HEIGHT;\n\
+    int y = get_global_id(0);\n\
+    int x = get_global_id(1);\n\
+    int localY = get_local_id(0);\n\
+    int localX = get_local_id(1);\n\
+    int groupHeight = get_local_size(0);\n\
+    int groupWidth = get_local_size(1);\n\
+    int tileHeight = groupHeight + 2;\n\
+    int tileWidth = groupWidth + 2;\n\
+    int tileX = get_group_id(1) * groupWidth - 1;\n\
+    int tileY = get_group_id(0) * groupHeight - 1;\n\
+    // 2 marks a healing cell, 1 a medicine cell that has not healed yet and 0 any other cell (or outside the grid)\n\
+    for (int i = localX * groupHeight + localY; i < tileWidth * tileHeight; i += groupWidth * groupHeight) {\n\
+        int gx = tileX + i / tileHeight;\n\
+        int gy = tileY + i % tileHeight;\n\
+        int _mark = 0;\n\
+        if (gx >= 0 && gx < width && gy >= 0 && gy < height) {\n\
+            int _state = writeQuad[gx*height + gy];\n\
+            if (_state == MEDICINE)\n\
+                _mark = 1;\n\
+            else if (_state == HEALTHY && readQuad[gx*height + gy] != HEALTHY)\n\
+                _mark = 2;\n\
+        }\n\
+        tile[i] = _mark;\n\
+    }\n\
+    int c = (localX + 1) * tileHeight + (localY + 1);\n\
+    bool _inside = x < width && y < height;\n\
+    // Spread within the tile, cells only ever go from 1 to 2 so reading a neighbour mid-update is harmless\n\
+    for (;;) {\n\
+        barrier(CLK_LOCAL_MEM_FENCE);\n\
+        if (localX == 0 && localY == 0)\n\
+            _spreading = 0;\n\
+        barrier(CLK_LOCAL_MEM_FENCE);\n\
+        if (_inside && tile[c] == 1 &&\n\
+            (tile[c - tileHeight - 1] == 2 || tile[c - 1] == 2 || tile[c + tileHeight - 1] == 2 ||\n\
+             tile[c - tileHeight] == 2 || tile[c + tileHeight] == 2 ||\n\
+             tile[c - tileHeight + 1] == 2 || tile[c + 1] == 2 || tile[c + tileHeight + 1] == 2)) {\n\
+            tile[c] = 2;\n\
+            _spreading = 1;\n\
+        }\n\
+        barrier(CLK_LOCAL_MEM_FENCE);\n\
+        if (!_spreading)\n\
+            break;\n\
+    }\n\
+    if (_inside && tile[c] == 2 && writeQuad[x*height + y] == MEDICINE) {\n\
+        writeQuad[x*height + y] = HEALTHY;\n\
+        if (localX == 0 || localY == 0 || localX == groupWidth - 1 || localY == groupHeight - 1)\n\
+            *changed = 1;\n\
+        if (counts) {\n\
+            atomic_dec(&counts[MEDICINE]);\n\
+            atomic_inc(&counts[HEALTHY]);\n\
+        }\n\
+    }\n\
+}\n\
+\n\
+__kernel void Inject(__global CELL* quad, __global const int* injections, int count)\n\
+{\n\
+    /**\n\
+    @Desc : Applies queued injections to the grid in the order they were made. Run by a single work item,\n\
+    as an injection depends on the cells changed by the ones before it\n\
+    @param1 : pointer to the grid\n\
+    @param2 : injections as (x, y, type) triples\n\
+    @param3 : number of injections\n\
+    */\n\
+    int width = WIDTH;\n\
+    int height = HEIGHT;\n\
+    for (int i = 0; i < count; i++) {\n\
+        int x = injections[3*i];\n\
+        int y = injections[3*i + 1];\n\
+        int _type = injections[3*i + 2];\n\
+        if (x < 0 || x >= width || y < 0 || y >= height)\n\
+            continue;\n\
+        // If medicine is injected on a cancer cell,\n\
+        // the medicine is absorbed and the cell turns into a healthy cell\n\
+        if (_type == MEDICINE && quad[x*height + y] == CANCER) {\n\
+            quad[x*height + y] = HEALTHY;\n\
+            continue;\n\
+        }\n\
+        // Otherwise it is not absorbed and propagates radially outwards by one cell\n\
+        for (int nx = max(x - 1, 0); nx <= min(x + 1, width - 1); nx++) {\n\
+            for (int ny = max(y - 1, 0); ny <= min(y + 1, height - 1); ny++)\n\
+                quad[nx*height + ny] = _type;\n\
         }\n\
     }\n\
 }\n\
 \n";
 
-int UpdateWithOpenCL()
+void AddSample(Phase phase, double milliseconds)
 {
     /**
-     @Desc : Helper function for using OpenCL to update cells in parallel. Launches the OpenCL GPU kernel
+     @Desc : Records one timing of a phase
+     @param1 : phase that was timed
+     @param2 : duration in milliseconds
      */
-    
-    // Write our initial data set into the read and write array in device memory
-    err = clEnqueueWriteBuffer(gpu_commands, readQuad, CL_TRUE, 0, sizeof(int) * g_totalSize, g_quad, 0, NULL, NULL);
-    if (err != CL_SUCCESS) {
-        printf("Error: Failed to write to source array!\n");
-        exit(1);
-    }
-    err = clEnqueueWriteBuffer(gpu_commands, writeQuad, CL_TRUE, 0, sizeof(int) * g_totalSize, g_quad, 0, NULL, NULL);
-    if (err != CL_SUCCESS) {
-        printf("Error: Failed to write to source array!\n");
-        exit(1);
-    }
-    
-    // Set the arguments to our compute kernel
-    err = 0;
-    err  = clSetKernelArg(gpu_kernel, 0, sizeof(cl_mem), &readQuad);
-    err |= clSetKernelArg(gpu_kernel, 1, sizeof(cl_mem), &writeQuad);
-    if (err != CL_SUCCESS) {
-        printf("Error: Failed to set kernel arguments! %d\n", err);
-        exit(1);
-    }
-    
-    // Get the maximum work group size for executing the kernel on the device
-    err = clGetKernelWorkGroupInfo(gpu_kernel, gpu_device_id, CL_KERNEL_WORK_GROUP_SIZE, sizeof(local), &local, NULL);
-    if (err != CL_SUCCESS) {
-        printf("Error: Failed to retrieve kernel work group info! %d\n", err);
-        exit(1);
-    }
-    
-    // Execute the kernel over the entire range of our 1D (actually 2D stored as 1D)
-    // input data set using the maximum number of work group items for this device
-    global = g_totalSize;
-    err = clEnqueueNDRangeKernel(gpu_commands, gpu_kernel, 1, NULL, &global, &local, 0, NULL, NULL);
-    if (err) {
-        printf("Error: Failed to execute kernel!\n");
-        return EXIT_FAILURE;
+
+    PhaseStats &_stats = g_phases[phase];
+    if (_stats.samples.size() < g_phaseWindow) {
+        _stats.samples.push_back(milliseconds);
     }
-    
-    // Wait for the command commands to get serviced before reading back results
-    clFinish(gpu_commands);
-    
-    // Read back the results from the device to change the output
-    err = clEnqueueReadBuffer(gpu_commands, writeQuad, CL_TRUE, 0, sizeof(int) * g_totalSize, g_quad, 0, NULL, NULL);
-    if (err != CL_SUCCESS) {
-        printf("Error: Failed to read output array! %d\n", err);
-        exit(1);
+    else {
+        _stats.samples[_stats.next] = milliseconds;
+        _stats.next = (_stats.next + 1) % g_phaseWindow;
     }
-    
-    return err;
+    _stats.count++;
 }
 
-void Update(int value)
+double EventSeconds(cl_event event)
 {
     /**
-     @Desc : Function that uses OpenCL to update the cells in parallel, and then calls itself (to update again)
-     @param1 : unused parameter that is passed by the glutTimerFunc
+     @Desc : Returns how long a finished command ran on its device (the queue must have profiling enabled)
+     @param1 : event of the command
      */
-    
-    // Update cells in parallel
-    UpdateWithOpenCL();
-    
-    glutPostRedisplay();
-    glutTimerFunc(g_updateTime, Update, 0);
+
+    cl_ulong _start = 0;
+    cl_ulong _end = 0;
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(_start), &_start, NULL);
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(_end), &_end, NULL);
+    return (_end - _start) * 1e-9;
 }
 
-void RenderBitmapString(float x, float y, void *font, const char *string)
+void TrackEvent(cl_event event, Phase phase)
 {
     /**
-     @Desc : Renders bitmap strings to display text on screen
-     @param1 : x position of where text should be displayed
-     @param2 : y position of where text should be displayed
-     @param3 : font to be used
-     @param4 : string text to be displayed on screen
+     @Desc : Takes over an event so its duration is added to a phase when the command completes
+     @param1 : event of the command (released once it has been read)
+     @param2 : phase the command belongs to
      */
-    
-    const char *c;
-    glRasterPos2f(x, y);
-    for (c = string; *c != '\0'; c++) {
-        glutBitmapCharacter(font, *c);
-    }
-}
 
-const char *KernelCPUSource = "\n\
-__kernel void UpdateWithCPU(__global int* colorQuad)\n\
-{\n\
-    /**\n\
-    @Desc : Updates each the display using CPU kernel\n\
-    @param1 : pointer to color array\n\
-    */\n\
-    int width = 1024;\n\
-    int height = 768;\n\
-    int i = get_global_id(0);\n\
-    int x = i / height;\n\
-    int y = i % height;\n\
-    int CANCER = 0;\n\
-    int HEALTHY = 1;\n\
-    int MEDICINE = 2;\n\
-}\n\
-\n";
+    PendingEvent _pending = {event, phase};
+    g_pendingEvents.push_back(_pending);
+}
 
-int UpdateDisplayWithOpenCL()
+void CollectEvents()
 {
     /**
-     @Desc : Helper function for using OpenCL to update display in parallel. Launches the OpenCL CPU kernel
+     @Desc : Adds the durations of the tracked commands that have completed to their phases
      */
-    
-    // Write our initial data set into the read array in device memory
-    err = clEnqueueWriteBuffer(cpu_commands, colorQuad, CL_TRUE, 0, sizeof(int) * g_totalSize, g_quad, 0, NULL, NULL);
-    if (err != CL_SUCCESS) {
-        printf("Error: Failed to write to source array!\n");
-        exit(1);
-    }
-    
-    // Set the arguments to our compute kernel
-    err = 0;
-    err  = clSetKernelArg(cpu_kernel, 0, sizeof(cl_mem), &colorQuad);
-    if (err != CL_SUCCESS) {
-        printf("Error: Failed to set kernel arguments! %d\n", err);
-        exit(1);
-    }
-    
-    // Get the maximum work group size for executing the kernel on the device
-    err = clGetKernelWorkGroupInfo(cpu_kernel, cpu_device_id, CL_KERNEL_WORK_GROUP_SIZE, sizeof(local), &local, NULL);
-    if (err != CL_SUCCESS) {
-        printf("Error: Failed to retrieve kernel work group info! %d\n", err);
-        exit(1);
-    }
-    
-    // Execute the kernel over the entire range of our 1D (actually 2D stored as 1D)
-    // input data set using the maximum number of work group items for this device
-    global = g_totalSize;
-    err = clEnqueueNDRangeKernel(cpu_commands, cpu_kernel, 1, NULL, &global, &local, 0, NULL, NULL);
-    if (err) {
-        printf("Error: Failed to execute kernel!\n");
-        return EXIT_FAILURE;
+
+    size_t _kept = 0;
+    for (size_t i = 0; i < g_pendingEvents.size(); i++) {
+        cl_int _status = CL_COMPLETE;
+        clGetEventInfo(g_pendingEvents[i].event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(_status), &_status, NULL);
+        if (_status == CL_COMPLETE) {
+            AddSample(g_pendingEvents[i].phase, EventSeconds(g_pendingEvents[i].event) * 1000.0);
+            clReleaseEvent(g_pendingEvents[i].event);
+        }
+        else if (_status > CL_COMPLETE) {
+            // Still queued or running
+            g_pendingEvents[_kept++] = g_pendingEvents[i];
+        }
+        else {
+            // The command failed, it has no timing
+            clReleaseEvent(g_pendingEvents[i].event);
+        }
     }
-    
-    // Wait for the command commands to get serviced before reading back results
-    clFinish(cpu_commands);
-    
-    return err;
+    g_pendingEvents.resize(_kept);
 }
 
-void Display()
+void PhaseSummary(Phase phase, double *mean, double *p50, double *p99)
 {
     /**
-     @Desc : Displays the cells and text in a window on screen
+     @Desc : Returns the mean, median and 99th percentile of the recent samples of a phase, in milliseconds
+     @param1 : phase to summarise
+     @param2 : receives the mean
+     @param3 : receives the median
+     @param4 : receives the 99th percentile
      */
-    
-    //UpdateDisplayWithOpenCL();
-    
-    // Display the cells using OpenGL
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glLoadIdentity();
-    
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    gluOrtho2D(0, g_windowWidth, g_windowHeight, 0);
-    
-    glClearColor(1, 1, 1, 1);
-    glClear(GL_COLOR_BUFFER_BIT);
-    glBegin(GL_QUADS);
-    int _healthyCount = 0;
-    int _cancerCount = 0;
-    int _medicineCount = 0;
-    for (int x = 0; x < g_windowWidth; x++)
-    {
-        for (int y = 0; y < g_windowHeight; y++)
-        {
-            if (g_quad[x][y] == HEALTHY)
-            {
-                // Healthy cells are green
-                glColor3f(0, 0.5, 0);
-                _healthyCount++;
-            }
-            else if (g_quad[x][y] == CANCER)
-            {
-                // Cancer cells are red
-                glColor3f(1, 0, 0);
-                _cancerCount++;
-            }
-            else if (g_quad[x][y] == MEDICINE)
-            {
-                // Medicine cells are yellow
-                glColor3f(1, 1, 0);
-                _medicineCount++;
-            }
-            glVertex2f(x, y);
-            glVertex2f(x + 1, y);
-            glVertex2f(x + 1, y + 1);
-            glVertex2f(x, y + 1);
-        }
-    }
-    glEnd();
-
-    std::string _hCount = std::to_string(static_cast<long long>(_healthyCount));
-    const char * _hc = _hCount.c_str();
-    std::string _cCount = std::to_string(static_cast<long long>(_cancerCount));
-    const char * _cc = _cCount.c_str();
-    std::string _mCount = std::to_string(static_cast<long long>(_medicineCount));
-    const char * _mc = _mCount.c_str();
-    
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
-    glLoadIdentity();
-    glColor3f(0, 0, 0);
-    // Display the number of each type of cell
-    RenderBitmapString(0, 30, g_font, "Healthy: ");
-    RenderBitmapString(0, 50, g_font, _hc);
-    RenderBitmapString(0, 100, g_font, "Cancer: ");
-    RenderBitmapString(0, 120, g_font, _cc);
-    RenderBitmapString(0, 170, g_font, "Medicine: ");
-    RenderBitmapString(0, 190, g_font, _mc);
-    glPopMatrix();
 
-    glutSwapBuffers();
+    std::vector<double> _sorted(g_phases[phase].samples);
+    *mean = *p50 = *p99 = 0.0;
+    if (_sorted.empty())
+        return;
+    std::sort(_sorted.begin(), _sorted.end());
+    double _total = 0.0;
+    for (size_t i = 0; i < _sorted.size(); i++)
+        _total += _sorted[i];
+    *mean = _total / _sorted.size();
+    *p50 = _sorted[_sorted.size() / 2];
+    *p99 = _sorted[std::min(_sorted.size() - 1, _sorted.size() * 99 / 100)];
 }
 
-void Initialize()
+void WriteProfileCsv()
 {
     /**
-     @Desc : Initialization function for glut
+     @Desc : Writes the summary of every phase to the profile CSV file (registered with atexit)
      */
-    
-    glMatrixMode(GL_PROJECTION);
-    glViewport(0, 0, g_windowWidth, g_windowHeight);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    GLfloat aspect = (GLfloat)g_windowWidth / g_windowHeight;
-    gluPerspective(45, aspect, 0.1f, 10.0f);
-    glClearColor(0.0, 0.0, 0.0, 0.0);
+
+    CollectEvents();
+    FILE *_file = fopen(g_profileCsv.c_str(), "w");
+    if (!_file)
+        return;
+    fprintf(_file, "phase,count,samples,mean_ms,p50_ms,p99_ms\n");
+    for (int p = 0; p < NUM_PHASES; p++) {
+        double _mean, _p50, _p99;
+        PhaseSummary((Phase)p, &_mean, &_p50, &_p99);
+        fprintf(_file, "%s,%lld,%d,%.4f,%.4f,%.4f\n", g_phaseNames[p], g_phases[p].count, (int)g_phases[p].samples.size(),
+            _mean, _p50, _p99);
+    }
+    fclose(_file);
+    printf("Wrote OpenCL phase timings to %s\n", g_profileCsv.c_str());
 }
 
-void MouseClicks(int button, int state, int x, int y)
+void CL_CALLBACK BatchFinished(cl_event event, cl_int status, void *data)
 {
     /**
-     @Desc : Function that handles mouse buttons being clicked
-     @param1 : mouse button that was clicked
-     @param2 : state of button that was clicked
-     @param3 : x position of pointer when mouse was clicked
-     @param4 : y position of pointer when mouse was clicked
+     @Desc : Called by OpenCL when the last kernel of a batch completed, measures the time per generation
+     @param1 : event of the last kernel in the batch
+     @param2 : execution status of the kernel
+     @param3 : the Batch that was enqueued (deleted here)
      */
-    
-    if (button == GLUT_LEFT_BUTTON && state == GLUT_DOWN) {
-        // If medicine is injected on a cancer cell,
-        // the medicine is absorbed and the cell turns into a healthy cell
-        if (g_quad[x][y] == CANCER) {
-            g_quad[x][y] = HEALTHY;
-        }
-        // If medicine is injected on a healthy or medicine cell,
-        // the medicine is not absorbed and propagates radially outwards by one cell
-        else {
-            g_quad[x][y] = MEDICINE;
-            if (x > 0 && y > 0)
-                g_quad[x - 1][y - 1] = MEDICINE;
-            if (y > 0)
-                g_quad[x][y - 1] = MEDICINE;
-            if (x < (g_windowWidth - 1) && y > 0)
-                g_quad[x + 1][y - 1] = MEDICINE;
-            if (x > 0)
-                g_quad[x - 1][y] = MEDICINE;
-            if (x < (g_windowWidth - 1))
-                g_quad[x + 1][y] = MEDICINE;
-            if (x > 0 && y < (g_windowHeight - 1))
-                g_quad[x - 1][y + 1] = MEDICINE;
-            if (y < (g_windowHeight - 1))
-                g_quad[x][y + 1] = MEDICINE;
-            if (x < (g_windowWidth - 1) && y < (g_windowHeight - 1))
-                g_quad[x + 1][y + 1] = MEDICINE;
-        }
-    }
+
+    Batch *_batch = (Batch *)data;
+    double _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _batch->start).count();
+    if (status == CL_COMPLETE)
+        g_secondsPerGeneration.store(_seconds / _batch->generations);
+    delete _batch;
+    clReleaseEvent(event);
 }
 
-void Keyboard(unsigned char key, int mousePositionX, int mousePositionY)
+int BatchSize()
 {
     /**
-     @Desc : Function that handles keyboard buttons being pressed
-     @param1 : key that was pressed
-     @param2 : x position of mouse pointer
-     @param3 : y position of mouse pointer
+     @Desc : Returns the number of generations to enqueue in the next update
      */
-    
-    switch (key)
-    {
-            // Escape key
-        case 27:
-            exit ( 0 );
-            break;
-            
-        default:
-            break;
+
+    if (!g_adaptiveBatch)
+        return g_batchSize;
+
+    // Fit the batch into the budget, moving halfway towards the target so one slow batch does not make it jump
+    double _perGeneration = g_secondsPerGeneration.load();
+    if (_perGeneration > 0.0) {
+        double _target = g_batchBudget * g_updateTime / 1000.0 / _perGeneration;
+        if (_target > g_maxBatch)
+            _target = g_maxBatch;
+        g_batchSize = (g_batchSize + (int)_target + 1) / 2;
+        if (g_batchSize < 1)
+            g_batchSize = 1;
     }
+    return g_batchSize;
 }
 
-int main(int argc, char **argv)
+int EnqueueKernel(cl_kernel kernel, KernelType type, cl_mem readQuad, cl_mem writeQuad, int rows, cl_mem counts, cl_event *event)
 {
     /**
-     @Desc : Main control thread
+     @Desc : Enqueues an update kernel on the GPU queue for one generation
+     @param1 : kernel to run
+     @param2 : which of the update kernels it is (they use different ranges)
+     @param3 : grid to read
+     @param4 : grid to write
+     @param5 : number of rows to update from the top (only the tiled kernel can update fewer than all of them)
+     @param6 : buffer the kernel adds the population of the new generation to (NULL to skip counting)
+     @param7 : receives the event of the kernel (may be NULL)
+     @return : error code of the enqueue
      */
 
-    // Connect to a GPU compute device
-    err = clGetDeviceIDs(NULL, CL_DEVICE_TYPE_GPU, 1, &gpu_device_id, NULL);
+    err = 0;
+    err  = clSetKernelArg(kernel, 0, sizeof(cl_mem), &readQuad);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &writeQuad);
+    if (type == TILED_KERNEL)
+        err |= clSetKernelArg(kernel, 3, sizeof(int), &rows);
+    err |= clSetKernelArg(kernel, type == TILED_KERNEL ? 4 : 2, sizeof(cl_mem), &counts);
     if (err != CL_SUCCESS) {
-        printf("Error: Failed to create a device group!\n");
-        return EXIT_FAILURE;
+        printf("Error: Failed to set kernel arguments! %d\n", err);
+        exit(1);
+    }
+
+    if (type == NAIVE_KERNEL) {
+        // Execute the kernel over the entire range of our 1D (actually 2D stored as 1D)
+        // input data set using the maximum number of work group items for this device
+        global = g_totalSize;
+        return clEnqueueNDRangeKernel(gpu_commands, kernel, 1, NULL, &global, &local, 0, NULL, event);
+    }
+
+    if (type == VECTOR_KERNEL) {
+        // One work item per run of 16 cells of a column
+        size_t _global[2] = {(size_t)g_windowHeight / 16, (size_t)g_windowWidth};
+        return clEnqueueNDRangeKernel(gpu_commands, kernel, 2, NULL, _global, NULL, 0, NULL, event);
+    }
+
+    // 2D range rounded up to whole work groups (y first, it is contiguous in memory)
+    size_t _global[2];
+    _global[0] = (rows + g_workGroup[0] - 1) / g_workGroup[0] * g_workGroup[0];
+    _global[1] = (g_windowWidth + g_workGroup[1] - 1) / g_workGroup[1] * g_workGroup[1];
+    return clEnqueueNDRangeKernel(gpu_commands, kernel, 2, NULL, _global, g_workGroup, 0, NULL, event);
+}
+
+int EnqueueGeneration(int rows, cl_mem counts, cl_event *event)
+{
+    /**
+     @Desc : Enqueues the selected update kernel for one generation, reading the latest generation and writing the other buffer
+     @param1 : number of rows to update from the top (the band above the split in heterogeneous mode)
+     @param2 : buffer the kernel adds the population of the new generation to (NULL to skip counting)
+     @param3 : receives the event of the kernel (may be NULL)
+     @return : error code of the enqueue
+     */
+
+    // Only the tiled kernel can update part of the rows
+    KernelType _type = rows < g_windowHeight ? TILED_KERNEL : g_kernelType;
+    cl_kernel _kernel = _type == TILED_KERNEL ? gpu_tiled_kernel : _type == VECTOR_KERNEL ? gpu_vector_kernel : gpu_kernel;
+    return EnqueueKernel(_kernel, _type, g_deviceQuad[g_current], g_deviceQuad[1 - g_current], rows, counts, event);
+}
+
+void ReadRows(cl_command_queue commands, cl_mem buffer, int yStart, int yEnd, Phase phase)
+{
+    /**
+     @Desc : Copies rows of a device grid into the same rows of g_quad (blocking)
+     @param1 : command queue of the device
+     @param2 : device grid
+     @param3 : first row
+     @param4 : one past the last row
+     @param5 : phase the copy is timed under
+     */
+
+    if (yEnd <= yStart)
+        return;
+    // A row is not contiguous, every column x holds a run of yEnd - yStart cells
+    size_t _origin[3] = {yStart * sizeof(cl_uchar), 0, 0};
+    size_t _region[3] = {(yEnd - yStart) * sizeof(cl_uchar), (size_t)g_windowWidth, 1};
+    cl_event _event;
+    err = clEnqueueReadBufferRect(commands, buffer, CL_TRUE, _origin, _origin, _region, g_windowHeight * sizeof(cl_uchar), 0,
+        g_windowHeight * sizeof(cl_uchar), 0, &g_quad[0], 0, NULL, &_event);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to read output array! %d\n", err);
+        exit(1);
+    }
+    TrackEvent(_event, phase);
+}
+
+void WriteRows(cl_command_queue commands, cl_mem buffer, int yStart, int yEnd, Phase phase)
+{
+    /**
+     @Desc : Copies rows of g_quad into the same rows of a device grid (blocking)
+     @param1 : command queue of the device
+     @param2 : device grid
+     @param3 : first row
+     @param4 : one past the last row
+     @param5 : phase the copy is timed under
+     */
+
+    if (yEnd <= yStart)
+        return;
+    size_t _origin[3] = {yStart * sizeof(cl_uchar), 0, 0};
+    size_t _region[3] = {(yEnd - yStart) * sizeof(cl_uchar), (size_t)g_windowWidth, 1};
+    cl_event _event;
+    err = clEnqueueWriteBufferRect(commands, buffer, CL_TRUE, _origin, _origin, _region, g_windowHeight * sizeof(cl_uchar), 0,
+        g_windowHeight * sizeof(cl_uchar), 0, &g_quad[0], 0, NULL, &_event);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to write to source array! %d\n", err);
+        exit(1);
+    }
+    TrackEvent(_event, phase);
+}
+
+void MoveSplit(int split)
+{
+    /**
+     @Desc : Moves the split between the two bands, handing the rows that change owner to the other device
+     @param1 : new first row of the CPU band
+     */
+
+    if (split > g_split) {
+        // The GPU takes over rows from the CPU, and needs the row below them as well
+        ReadRows(cpu_commands, g_cpuQuad[g_current], g_split, split + 1, HALO_PHASE);
+        WriteRows(gpu_commands, g_deviceQuad[g_current], g_split, split + 1, HALO_PHASE);
+    }
+    else if (split < g_split) {
+        // The CPU takes over rows from the GPU, and needs the row above them as well
+        ReadRows(gpu_commands, g_deviceQuad[g_current], split - 1, g_split, HALO_PHASE);
+        WriteRows(cpu_commands, g_cpuQuad[g_current], split - 1, g_split, HALO_PHASE);
+    }
+    g_split = split;
+}
+
+void BalanceSplit()
+{
+    /**
+     @Desc : Moves the split towards the row where both bands take the same time, based on the kernel times
+     measured since the last call
+     */
+
+    if (g_gpuBandSeconds > 0.0 && g_cpuBandSeconds > 0.0) {
+        // Rows per second on each device
+        double _gpuRate = g_split / g_gpuBandSeconds;
+        double _cpuRate = (g_windowHeight - g_split) / g_cpuBandSeconds;
+        int _target = (int)(g_windowHeight * _gpuRate / (_gpuRate + _cpuRate));
+        // Move at most an eighth of the grid at a time, and ignore small differences so the split does not jitter
+        int _step = std::max(-g_windowHeight / 8, std::min(g_windowHeight / 8, _target - g_split));
+        if (abs(_step) >= g_windowHeight / 64)
+            MoveSplit(std::max(g_minBand, std::min(g_windowHeight - g_minBand, g_split + _step)));
+    }
+    g_balanceGenerations = 0;
+    g_gpuBandSeconds = 0.0;
+    g_cpuBandSeconds = 0.0;
+}
+
+void UpdateBands(bool count)
+{
+    /**
+     @Desc : Runs one generation in heterogeneous mode. The GPU updates its band with the tiled kernel and the CPU
+     its band with UpdateWithCPU, then the rows on either side of the split are exchanged through the host
+     @param1 : whether each device counts the population of its band
+     */
+
+    cl_event _events[2];
+    err = EnqueueGeneration(g_split, count ? g_countsBuffer : NULL, &_events[0]);
+    if (err) {
+        printf("Error: Failed to execute kernel!\n");
+        exit(1);
+    }
+
+    err = 0;
+    err  = clSetKernelArg(cpu_kernel, 0, sizeof(cl_mem), &g_cpuQuad[g_current]);
+    err |= clSetKernelArg(cpu_kernel, 1, sizeof(cl_mem), &g_cpuQuad[1 - g_current]);
+    cl_mem _counts = count ? g_cpuCountsBuffer : NULL;
+    err |= clSetKernelArg(cpu_kernel, 2, sizeof(cl_mem), &_counts);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to set kernel arguments! %d\n", err);
+        exit(1);
+    }
+    // Dimension 0 runs along y and starts at the first row of the band
+    size_t _offset[2] = {(size_t)g_split, 0};
+    size_t _global[2] = {(size_t)(g_windowHeight - g_split), (size_t)g_windowWidth};
+    err = clEnqueueNDRangeKernel(cpu_commands, cpu_kernel, 2, _offset, _global, NULL, 0, NULL, &_events[1]);
+    if (err) {
+        printf("Error: Failed to execute kernel!\n");
+        exit(1);
+    }
+    clFlush(gpu_commands);
+    clFlush(cpu_commands);
+    g_current = 1 - g_current;
+
+    // Each device needs the first row of the other band for the next generation (the blocking reads wait for the kernels)
+    ReadRows(cpu_commands, g_cpuQuad[g_current], g_split, g_split + 1, HALO_PHASE);
+    WriteRows(gpu_commands, g_deviceQuad[g_current], g_split, g_split + 1, HALO_PHASE);
+    ReadRows(gpu_commands, g_deviceQuad[g_current], g_split - 1, g_split, HALO_PHASE);
+    WriteRows(cpu_commands, g_cpuQuad[g_current], g_split - 1, g_split, HALO_PHASE);
+
+    clWaitForEvents(2, _events);
+    g_gpuBandSeconds += EventSeconds(_events[0]);
+    g_cpuBandSeconds += EventSeconds(_events[1]);
+    TrackEvent(_events[0], KERNEL_PHASE);
+    TrackEvent(_events[1], KERNEL_PHASE);
+    if (++g_balanceGenerations == g_balanceInterval)
+        BalanceSplit();
+}
+
+void Unmap()
+{
+    /**
+     @Desc : Hands the mapped device grid back to the device (zero-copy mode)
+     */
+
+    if (!g_mappedQuad)
+        return;
+    // The map of a batch that was never drawn was not waited on by ReadBack, the profiler takes over its event
+    if (g_mapEvent) {
+        TrackEvent(g_mapEvent, READBACK_PHASE);
+        g_mapEvent = NULL;
+    }
+    cl_event _event;
+    err = clEnqueueUnmapMemObject(gpu_commands, g_mappedQuad, g_cells, 0, NULL, &_event);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to unmap output array! %d\n", err);
+        exit(1);
+    }
+    TrackEvent(_event, READBACK_PHASE);
+    g_mappedQuad = NULL;
+    g_cells = &g_quad[0];
+}
+
+void MapLatest()
+{
+    /**
+     @Desc : Enqueues a map of the latest generation behind the kernels without waiting for it, so Cell reads
+     the device grid in place once ReadBack has waited for the map (zero-copy mode)
+     */
+
+    // A batch that was never drawn still holds its map and map event
+    Unmap();
+    g_mappedQuad = g_deviceQuad[g_current];
+    g_cells = (cl_uchar *)clEnqueueMapBuffer(gpu_commands, g_mappedQuad, CL_FALSE, CL_MAP_READ, 0,
+        sizeof(cl_uchar) * g_totalSize, 0, NULL, &g_mapEvent, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to map output array! %d\n", err);
+        exit(1);
+    }
+}
+
+void EnqueueInjections(cl_command_queue commands, cl_kernel kernel, cl_mem injections, cl_mem quad, const std::vector<cl_int> &queued)
+{
+    /**
+     @Desc : Applies injections to a device grid
+     @param1 : command queue of the device
+     @param2 : Inject kernel of the device
+     @param3 : injection buffer of the device
+     @param4 : device grid
+     @param5 : injections as (x, y, type) triples, in the order they were made
+     */
+
+    int _total = (int)queued.size() / 3;
+    for (int first = 0; first < _total; first += g_maxInjections) {
+        int _count = std::min(g_maxInjections, _total - first);
+        cl_event _event;
+        err = clEnqueueWriteBuffer(commands, injections, CL_TRUE, 0, sizeof(cl_int) * 3 * _count, &queued[3 * first], 0, NULL, &_event);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to write to source array!\n");
+            exit(1);
+        }
+        TrackEvent(_event, UPLOAD_PHASE);
+
+        err  = clSetKernelArg(kernel, 0, sizeof(cl_mem), &quad);
+        err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &injections);
+        err |= clSetKernelArg(kernel, 2, sizeof(int), &_count);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to set kernel arguments! %d\n", err);
+            exit(1);
+        }
+        // The injections depend on each other, a single work item applies them in order
+        size_t _one = 1;
+        err = clEnqueueNDRangeKernel(commands, kernel, 1, NULL, &_one, &_one, 0, NULL, &_event);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to execute kernel!\n");
+            exit(1);
+        }
+        TrackEvent(_event, INJECT_PHASE);
+    }
+}
+
+void CopyCells(cl_command_queue fromCommands, cl_mem from, cl_command_queue toCommands, cl_mem to, int xStart, int xEnd, int yStart, int yEnd)
+{
+    /**
+     @Desc : Copies a rectangle of cells from one device grid to the same cells of another, through g_quad (blocking)
+     @param1 : command queue of the device holding the cells
+     @param2 : device grid holding the cells
+     @param3 : command queue of the device receiving the cells
+     @param4 : device grid receiving the cells
+     @param5 : first column
+     @param6 : one past the last column
+     @param7 : first row
+     @param8 : one past the last row
+     */
+
+    size_t _origin[3] = {yStart * sizeof(cl_uchar), (size_t)xStart, 0};
+    size_t _region[3] = {(yEnd - yStart) * sizeof(cl_uchar), (size_t)(xEnd - xStart), 1};
+    cl_event _event;
+    err = clEnqueueReadBufferRect(fromCommands, from, CL_TRUE, _origin, _origin, _region, g_windowHeight * sizeof(cl_uchar), 0,
+        g_windowHeight * sizeof(cl_uchar), 0, &g_quad[0], 0, NULL, &_event);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to read output array! %d\n", err);
+        exit(1);
+    }
+    TrackEvent(_event, HALO_PHASE);
+    err = clEnqueueWriteBufferRect(toCommands, to, CL_TRUE, _origin, _origin, _region, g_windowHeight * sizeof(cl_uchar), 0,
+        g_windowHeight * sizeof(cl_uchar), 0, &g_quad[0], 0, NULL, &_event);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to write to source array! %d\n", err);
+        exit(1);
+    }
+    TrackEvent(_event, HALO_PHASE);
+}
+
+void EnqueueBandInjections()
+{
+    /**
+     @Desc : Applies the queued injections in heterogeneous mode. Each injection is applied by the device that updates
+     the cell it lands on, as only that device holds the cell. An injection that reaches the rows on either side of
+     the split (the halo rows) also changes cells the other device reads, so those cells are copied across before
+     any later injection can read them
+     */
+
+    std::vector<cl_int> _gpuQueued;
+    std::vector<cl_int> _cpuQueued;
+    for (size_t i = 0; i + 2 < g_injections.size(); i += 3) {
+        int x = g_injections[i];
+        int y = g_injections[i + 1];
+        if (x < 0 || x >= g_windowWidth || y < 0 || y >= g_windowHeight)
+            continue;
+        bool _onGpu = y < g_split;
+        std::vector<cl_int> &_queued = _onGpu ? _gpuQueued : _cpuQueued;
+        _queued.insert(_queued.end(), g_injections.begin() + i, g_injections.begin() + i + 3);
+
+        // Injections further from the split only touch cells that no other device reads, they wait to go in one batch
+        if (y < g_split - 2 || y > g_split + 1)
+            continue;
+        int _xStart = std::max(x - 1, 0);
+        int _xEnd = std::min(x + 1, g_windowWidth - 1) + 1;
+        int _yStart = std::max(y - 1, g_split - 1);
+        int _yEnd = std::min(y + 1, g_split) + 1;
+        if (_onGpu) {
+            EnqueueInjections(gpu_commands, gpu_inject_kernel, g_injectionBuffer, g_deviceQuad[g_current], _queued);
+            CopyCells(gpu_commands, g_deviceQuad[g_current], cpu_commands, g_cpuQuad[g_current], _xStart, _xEnd, _yStart, _yEnd);
+        }
+        else {
+            EnqueueInjections(cpu_commands, cpu_inject_kernel, g_cpuInjectionBuffer, g_cpuQuad[g_current], _queued);
+            CopyCells(cpu_commands, g_cpuQuad[g_current], gpu_commands, g_deviceQuad[g_current], _xStart, _xEnd, _yStart, _yEnd);
+        }
+        _queued.clear();
+    }
+    EnqueueInjections(gpu_commands, gpu_inject_kernel, g_injectionBuffer, g_deviceQuad[g_current], _gpuQueued);
+    EnqueueInjections(cpu_commands, cpu_inject_kernel, g_cpuInjectionBuffer, g_cpuQuad[g_current], _cpuQueued);
+}
+
+void EnqueueCascade(cl_mem counts)
+{
+    /**
+     @Desc : Runs the heal cascade on the generation just enqueued, from the latest generation into the other buffer.
+     Waits for the changed flag after every round
+     @param1 : buffer holding the population of the new generation, the healed cells are moved in it (may be NULL)
+     */
+
+    err  = clSetKernelArg(gpu_cascade_kernel, 0, sizeof(cl_mem), &g_deviceQuad[g_current]);
+    err |= clSetKernelArg(gpu_cascade_kernel, 1, sizeof(cl_mem), &g_deviceQuad[1 - g_current]);
+    err |= clSetKernelArg(gpu_cascade_kernel, 3, sizeof(cl_mem), &g_changedBuffer);
+    err |= clSetKernelArg(gpu_cascade_kernel, 4, sizeof(cl_mem), &counts);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to set kernel arguments! %d\n", err);
+        exit(1);
+    }
+    size_t _global[2];
+    _global[0] = (g_windowHeight + g_workGroup[0] - 1) / g_workGroup[0] * g_workGroup[0];
+    _global[1] = (g_windowWidth + g_workGroup[1] - 1) / g_workGroup[1] * g_workGroup[1];
+
+    cl_int _changed = 1;
+    while (_changed) {
+        cl_int _zero = 0;
+        cl_event _event;
+        err  = clEnqueueFillBuffer(gpu_commands, g_changedBuffer, &_zero, sizeof(_zero), 0, sizeof(cl_int), 0, NULL, NULL);
+        err |= clEnqueueNDRangeKernel(gpu_commands, gpu_cascade_kernel, 2, NULL, _global, g_workGroup, 0, NULL, &_event);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to execute kernel!\n");
+            exit(1);
+        }
+        TrackEvent(_event, CASCADE_PHASE);
+        err = clEnqueueReadBuffer(gpu_commands, g_changedBuffer, CL_TRUE, 0, sizeof(cl_int), &_changed, 0, NULL, NULL);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to read output array! %d\n", err);
+            exit(1);
+        }
+    }
+}
+
+void ClearCounts()
+{
+    /**
+     @Desc : Zeroes the counts buffers before the kernel that counts the population
+     */
+
+    cl_int _zero = 0;
+    err = clEnqueueFillBuffer(gpu_commands, g_countsBuffer, &_zero, sizeof(_zero), 0, sizeof(cl_int) * 3, 0, NULL, NULL);
+    if (g_heterogeneous)
+        err |= clEnqueueFillBuffer(cpu_commands, g_cpuCountsBuffer, &_zero, sizeof(_zero), 0, sizeof(cl_int) * 3, 0, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to clear the counts! %d\n", err);
+        exit(1);
+    }
+}
+
+void ReadCounts()
+{
+    /**
+     @Desc : Enqueues reads of the counts behind the kernel that wrote them, without waiting for them
+     */
+
+    // Reads that were never waited for are superseded by these ones, which run after them
+    for (size_t i = 0; i < g_countReads.size(); i++)
+        TrackEvent(g_countReads[i], COUNTS_PHASE);
+    g_countReads.clear();
+
+    cl_event _event;
+    err = clEnqueueReadBuffer(gpu_commands, g_countsBuffer, CL_FALSE, 0, sizeof(cl_int) * 3, g_population, 0, NULL, &_event);
+    g_countReads.push_back(_event);
+    if (g_heterogeneous) {
+        err |= clEnqueueReadBuffer(cpu_commands, g_cpuCountsBuffer, CL_FALSE, 0, sizeof(cl_int) * 3, g_cpuPopulation, 0, NULL, &_event);
+        g_countReads.push_back(_event);
+    }
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to read the counts! %d\n", err);
+        exit(1);
+    }
+}
+
+const cl_int *Population()
+{
+    /**
+     @Desc : Returns the population of each state after the latest generation, indexed by state (waits for the
+     counts of the latest batch if they are still being read)
+     */
+
+    if (g_countReads.empty())
+        return g_population;
+    clWaitForEvents((cl_uint)g_countReads.size(), &g_countReads[0]);
+    for (size_t i = 0; i < g_countReads.size(); i++)
+        TrackEvent(g_countReads[i], COUNTS_PHASE);
+    g_countReads.clear();
+    if (g_heterogeneous) {
+        for (int i = 0; i < 3; i++)
+            g_population[i] += g_cpuPopulation[i];
+    }
+    if (g_population[MEDICINE] == 0 && g_injections.empty())
+        g_medicinePresent = false;
+    return g_population;
+}
+
+int UpdateWithOpenCL(int generations)
+{
+    /**
+     @Desc : Helper function for using OpenCL to update cells in parallel. Enqueues the OpenCL GPU kernel
+     for several generations back to back without waiting for any of them (see ReadBack)
+     @param1 : number of generations to run
+     */
+    
+    CollectEvents();
+    // The kernels write the mapped grid, it has to be given back first
+    Unmap();
+
+    // Only upload the grid when the host changed it since the last generation
+    if (g_uploadPending) {
+        cl_event _event;
+        err = clEnqueueWriteBuffer(gpu_commands, g_deviceQuad[g_current], CL_TRUE, 0, sizeof(cl_uchar) * g_totalSize, &g_quad[0], 0, NULL, &_event);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to write to source array!\n");
+            exit(1);
+        }
+        TrackEvent(_event, UPLOAD_PHASE);
+        if (g_heterogeneous) {
+            err = clEnqueueWriteBuffer(cpu_commands, g_cpuQuad[g_current], CL_TRUE, 0, sizeof(cl_uchar) * g_totalSize, &g_quad[0], 0, NULL, &_event);
+            if (err != CL_SUCCESS) {
+                printf("Error: Failed to write to source array!\n");
+                exit(1);
+            }
+            TrackEvent(_event, UPLOAD_PHASE);
+        }
+        g_uploadPending = false;
+    }
+
+    if (!g_injections.empty()) {
+        if (g_heterogeneous)
+            EnqueueBandInjections();
+        else
+            EnqueueInjections(gpu_commands, gpu_inject_kernel, g_injectionBuffer, g_deviceQuad[g_current], g_injections);
+        g_injections.clear();
+    }
+
+    // Only the last generation of the batch is counted
+    if (generations > 0)
+        ClearCounts();
+
+    if (g_heterogeneous) {
+        // The halo exchange waits for every generation, so the batch is timed here rather than by an event callback
+        auto _start = std::chrono::steady_clock::now();
+        for (int g = 0; g < generations; g++)
+            UpdateBands(g == generations - 1);
+        if (generations > 0)
+            ReadCounts();
+        if (generations > 0)
+            g_secondsPerGeneration.store(std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count() / generations);
+        g_readbackPending = true;
+        return err;
+    }
+    
+    auto _start = std::chrono::steady_clock::now();
+    for (int g = 0; g < generations; g++) {
+        cl_event _event;
+        cl_mem _counts = g == generations - 1 ? g_countsBuffer : NULL;
+        err = EnqueueGeneration(g_windowHeight, _counts, &_event);
+        if (err) {
+            printf("Error: Failed to execute kernel!\n");
+            return EXIT_FAILURE;
+        }
+        if (g_cascade && g_medicinePresent)
+            EnqueueCascade(_counts);
+        // The last kernel of an adaptive batch also times the whole batch (the callback holds its own reference)
+        if (g_adaptiveBatch && g == generations - 1) {
+            clRetainEvent(_event);
+            clSetEventCallback(_event, CL_COMPLETE, BatchFinished, new Batch{_start, generations});
+        }
+        TrackEvent(_event, KERNEL_PHASE);
+        g_current = 1 - g_current;
+    }
+    
+    if (generations > 0)
+        ReadCounts();
+    // The map runs right behind the batch, so the grid is ready without another round trip when it is drawn
+    if (g_zeroCopy)
+        MapLatest();
+
+    // Start the batch without waiting for it
+    clFlush(gpu_commands);
+    g_readbackPending = true;
+    
+    return err;
+}
+
+void ReadBack()
+{
+    /**
+     @Desc : Reads the latest generation back into g_quad if the device is ahead of it (in zero-copy mode, waits
+     for the map of the latest generation instead)
+     */
+
+    if (!g_readbackPending)
+        return;
+
+    auto _start = std::chrono::steady_clock::now();
+    if (g_heterogeneous) {
+        // Each band comes from the device that updates it
+        ReadRows(gpu_commands, g_deviceQuad[g_current], 0, g_split, READBACK_PHASE);
+        ReadRows(cpu_commands, g_cpuQuad[g_current], g_split, g_windowHeight, READBACK_PHASE);
+    }
+    else if (g_zeroCopy) {
+        // The map completes after the rest of the batch
+        clWaitForEvents(1, &g_mapEvent);
+        TrackEvent(g_mapEvent, READBACK_PHASE);
+        g_mapEvent = NULL;
+    }
+    else {
+        // The blocking read waits for the rest of the batch
+        cl_event _event;
+        err = clEnqueueReadBuffer(gpu_commands, g_deviceQuad[g_current], CL_TRUE, 0, sizeof(cl_uchar) * g_totalSize, &g_quad[0], 0, NULL, &_event);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to read output array! %d\n", err);
+            exit(1);
+        }
+        TrackEvent(_event, READBACK_PHASE);
+    }
+    g_readbackPending = false;
+    AddSample(WAIT_PHASE, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count());
+    CollectEvents();
+}
+
+void ReportFrameStats()
+{
+    /**
+     @Desc : Prints the pacer measurements once per measurement interval, with the batch size and the hetero split
+     */
+
+    if (!g_pacer.ReportDue())
+        return;
+
+    char _details[48];
+    sprintf(_details, ", %d generations per batch", g_batchSize);
+    g_pacer.Report(_details);
+    if (g_heterogeneous)
+        printf("[hetero] GPU updates rows 0-%d, CPU rows %d-%d\n", g_split - 1, g_split, g_windowHeight - 1);
+}
+
+void Update(int value)
+{
+    /**
+     @Desc : Function that uses OpenCL to update the cells in parallel, and then calls itself (to update again)
+     @param1 : unused parameter that is passed by the glutTimerFunc
+     */
+    
+    // Update cells in parallel, the result is read back when the next frame is drawn
+    int _generations = BatchSize();
+    UpdateWithOpenCL(_generations);
+    
+    g_pacer.GenerationsDone(_generations);
+    ReportFrameStats();
+
+    g_pacer.RequestRedisplay();
+    glutTimerFunc(g_updateTime, Update, 0);
+}
+
+void RenderBitmapString(float x, float y, void *font, const char *string)
+{
+    /**
+     @Desc : Renders bitmap strings to display text on screen
+     @param1 : x position of where text should be displayed
+     @param2 : y position of where text should be displayed
+     @param3 : font to be used
+     @param4 : string text to be displayed on screen
+     */
+    
+    const char *c;
+    glRasterPos2f(x, y);
+    for (c = string; *c != '\0'; c++) {
+        glutBitmapCharacter(font, *c);
+    }
+}
+
+const char *KernelCPUSource = "\n\
+// The grid size, rule and states come from the host as build options (see KernelOptions)\n\
+#if !defined(WIDTH) || !defined(HEIGHT) || !defined(THRESH) || !defined(CANCER) || !defined(HEALTHY) || !defined(MEDICINE)\n\
+#error Build with -DWIDTH=... -DHEIGHT=... -DTHRESH=... -DCANCER=... -DHEALTHY=... -DMEDICINE=...\n\
+#endif\n\
+#ifndef CELL\n\
+#define CELL uchar\n\
+#endif\n\
+\n\
+// Adds the new states of a work group to the population counts (indexed by state): a histogram in local memory,\n\
+// then one atomic per state. Every work item of the group must call it, with zeros if it updated no cell\n\
+void CountPopulation(__local int* histogram, __global int* counts, int cancer, int healthy, int medicine)\n\
+{\n\
+    int _id = get_local_id(1) * get_local_size(0) + get_local_id(0);\n\
+    int _size = get_local_size(0) * get_local_size(1);\n\
+    for (int i = _id; i < 3; i += _size)\n\
+        histogram[i] = 0;\n\
+    barrier(CLK_LOCAL_MEM_FENCE);\n\
+    if (cancer)\n\
+        atomic_add(&histogram[CANCER], cancer);\n\
+    if (healthy)\n\
+        atomic_add(&histogram[HEALTHY], healthy);\n\
+    if (medicine)\n\
+        atomic_add(&histogram[MEDICINE], medicine);\n\
+    barrier(CLK_LOCAL_MEM_FENCE);\n\
+    for (int i = _id; i < 3; i += _size) {\n\
+        if (histogram[i])\n\
+            atomic_add(&counts[i], histogram[i]);\n\
+    }\n\
+}\n\
+\n\
+__kernel void UpdateWithCPU(__global const CELL* readQuad, __global CELL* writeQuad, __global int* counts)\n\
+{\n\
+    /**\n\
+    @Desc : Updates each cell state of the CPU band using CPU kernel. Dimension 0 of the range runs along y\n\
+    and starts at the first row of the band, dimension 1 runs along x\n\
+    @param1 : pointer to read array\n\
+    @param2 : pointer to write array\n\
+    @param3 : population counts to add the new states to (NULL to skip counting)\n\
+    */\n\
+    __local int _histogram[3];\n\
+    int width = WIDTH;\n\
+    int height = HEIGHT;\n\
+    int y = get_global_id(0);\n\
+    int x = get_global_id(1);\n\
+    int _state = readQuad[x*height + y];\n\
+    if (_state == HEALTHY || _state == CANCER) {\n\
+        // Healthy cells count cancer neighbours, cancer cells count medicine neighbours\n\
+        int _before = (_state == HEALTHY) ? CANCER : MEDICINE;\n\
+        int _numSurrounded = 0;\n\
+        for (int nx = max(x - 1, 0); nx <= min(x + 1, width - 1); nx++) {\n\
+            for (int ny = max(y - 1, 0); ny <= min(y + 1, height - 1); ny++) {\n\
+                if ((nx != x || ny != y) && readQuad[nx*height + ny] == _before)\n\
+                    _numSurrounded++;\n\
+            }\n\
+        }\n\
+        // Change state if surrounded by >= THRESH of a certain cell\n\
+        if (_numSurrounded >= THRESH)\n\
+            _state = (_state == HEALTHY) ? CANCER : HEALTHY;\n\
+    }\n\
+    writeQuad[x*height + y] = _state;\n\
+    if (counts)\n\
+        CountPopulation(_histogram, counts, _state == CANCER, _state == HEALTHY, _state == MEDICINE);\n\
+}\n\
+\n\
+__kernel void Inject(__global CELL* quad, __global const int* injections, int count)\n\
+{\n\
+    /**\n\
+    @Desc : Applies queued injections to the grid in the order they were made. Run by a single work item,\n\
+    as an injection depends on the cells changed by the ones before it\n\
+    @param1 : pointer to the grid\n\
+    @param2 : injections as (x, y, type) triples\n\
+    @param3 : number of injections\n\
+    */\n\
+    int width = WIDTH;\n\
+    int height = HEIGHT;\n\
+    for (int i = 0; i < count; i++) {\n\
+        int x = injections[3*i];\n\
+        int y = injections[3*i + 1];\n\
+        int _type = injections[3*i + 2];\n\
+        if (x < 0 || x >= width || y < 0 || y >= height)\n\
+            continue;\n\
+        // If medicine is injected on a cancer cell,\n\
+        // the medicine is absorbed and the cell turns into a healthy cell\n\
+        if (_type == MEDICINE && quad[x*height + y] == CANCER) {\n\
+            quad[x*height + y] = HEALTHY;\n\
+            continue;\n\
+        }\n\
+        // Otherwise it is not absorbed and propagates radially outwards by one cell\n\
+        for (int nx = max(x - 1, 0); nx <= min(x + 1, width - 1); nx++) {\n\
+            for (int ny = max(y - 1, 0); ny <= min(y + 1, height - 1); ny++)\n\
+                quad[nx*height + ny] = _type;\n\
+        }\n\
+    }\n\
+}\n\
+\n";
+
+void Display()
+{
+    /**
+     @Desc : Displays the cells and text in a window on screen
+     */
+
+    g_pacer.FrameDrawn();
+    ReadBack();
+    
+    // Display the cells using OpenGL
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glLoadIdentity();
+    
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluOrtho2D(0, g_windowWidth, g_windowHeight, 0);
+    
+    glClearColor(1, 1, 1, 1);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glBegin(GL_QUADS);
+    for (int x = 0; x < g_windowWidth; x++)
+    {
+        for (int y = 0; y < g_windowHeight; y++)
+        {
+            if (Cell(x, y) == HEALTHY)
+            {
+                // Healthy cells are green
+                glColor3f(0, 0.5, 0);
+            }
+            else if (Cell(x, y) == CANCER)
+            {
+                // Cancer cells are red
+                glColor3f(1, 0, 0);
+            }
+            else if (Cell(x, y) == MEDICINE)
+            {
+                // Medicine cells are yellow
+                glColor3f(1, 1, 0);
+            }
+            glVertex2f(x, y);
+            glVertex2f(x + 1, y);
+            glVertex2f(x + 1, y + 1);
+            glVertex2f(x, y + 1);
+        }
+    }
+    glEnd();
+
+    // The device counted the cells while updating them
+    const cl_int *_population = Population();
+    std::string _hCount = std::to_string(static_cast<long long>(_population[HEALTHY]));
+    const char * _hc = _hCount.c_str();
+    std::string _cCount = std::to_string(static_cast<long long>(_population[CANCER]));
+    const char * _cc = _cCount.c_str();
+    std::string _mCount = std::to_string(static_cast<long long>(_population[MEDICINE]));
+    const char * _mc = _mCount.c_str();
+    
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    glColor3f(0, 0, 0);
+    // Display the number of each type of cell
+    RenderBitmapString(0, 30, g_font, "Healthy: ");
+    RenderBitmapString(0, 50, g_font, _hc);
+    RenderBitmapString(0, 100, g_font, "Cancer: ");
+    RenderBitmapString(0, 120, g_font, _cc);
+    RenderBitmapString(0, 170, g_font, "Medicine: ");
+    RenderBitmapString(0, 190, g_font, _mc);
+    // OpenCL time per phase over the most recent samples
+    float _line = 240;
+    for (int p = 0; p < NUM_PHASES; p++) {
+        if (g_phases[p].samples.empty())
+            continue;
+        double _mean, _p50, _p99;
+        PhaseSummary((Phase)p, &_mean, &_p50, &_p99);
+        char _text[128];
+        snprintf(_text, sizeof(_text), "%s: mean %.2f  p50 %.2f  p99 %.2f ms", g_phaseNames[p], _mean, _p50, _p99);
+        RenderBitmapString(0, _line, GLUT_BITMAP_HELVETICA_12, _text);
+        _line += 16;
+    }
+    glPopMatrix();
+
+    glutSwapBuffers();
+}
+
+void Initialize()
+{
+    /**
+     @Desc : Initialization function for glut
+     */
+    
+    glMatrixMode(GL_PROJECTION);
+    glViewport(0, 0, glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT));
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    GLfloat aspect = (GLfloat)g_windowWidth / g_windowHeight;
+    gluPerspective(45, aspect, 0.1f, 10.0f);
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+}
+
+void InjectMedicine(int x, int y)
+{
+    /**
+     @Desc : Queues an injection of medicine into a cell of the grid. It is applied on the device before
+     the next generation (see EnqueueInjections)
+     @param1 : x position of the cell
+     @param2 : y position of the cell
+     */
+
+    g_injections.push_back(x);
+    g_injections.push_back(y);
+    g_injections.push_back(MEDICINE);
+    g_medicinePresent = true;
+}
+
+void MouseClicks(int button, int state, int x, int y)
+{
+    /**
+     @Desc : Function that handles mouse buttons being clicked
+     @param1 : mouse button that was clicked
+     @param2 : state of button that was clicked
+     @param3 : x position of pointer when mouse was clicked
+     @param4 : y position of pointer when mouse was clicked
+     */
+    
+    if (button == GLUT_LEFT_BUTTON && state == GLUT_DOWN) {
+        // The window can be smaller than the grid, scale the pointer position to a cell
+        x = x * g_windowWidth / glutGet(GLUT_WINDOW_WIDTH);
+        y = y * g_windowHeight / glutGet(GLUT_WINDOW_HEIGHT);
+        if (x >= 0 && x < g_windowWidth && y >= 0 && y < g_windowHeight)
+            InjectMedicine(x, y);
+    }
+}
+
+void SetPacer(bool enabled)
+{
+    /**
+     @Desc : Switches between drawing on change and redrawing continuously from the idle function
+     @param1 : true to only draw when something changed
+     */
+
+    g_pacer.SetEnabled(enabled);
+    glutIdleFunc(enabled ? NULL : Display);
+    // Each report only covers one mode
+    g_pacer.ResetStats();
+    glutPostRedisplay();
+}
+
+void Keyboard(unsigned char key, int mousePositionX, int mousePositionY)
+{
+    /**
+     @Desc : Function that handles keyboard buttons being pressed
+     @param1 : key that was pressed
+     @param2 : x position of mouse pointer
+     @param3 : y position of mouse pointer
+     */
+    
+    switch (key)
+    {
+            // Escape key
+        case 27:
+            exit ( 0 );
+            break;
+
+            // Toggle the frame pacer
+        case 'p':
+            SetPacer(!g_pacer.Enabled());
+            break;
+            
+        default:
+            break;
+    }
+}
+
+bool SelectDevice(cl_device_type type, cl_device_id *device)
+{
+    /**
+     @Desc : Finds a compute device of the requested type on any platform, or the first device of any type
+     if there is none (e.g. only a CPU implementation such as PoCL is installed)
+     @param1 : preferred device type
+     @param2 : receives the selected device
+     @return : false if there is no OpenCL device at all
+     */
+
+    cl_platform_id _platforms[8];
+    cl_uint _numPlatforms = 0;
+    if (clGetPlatformIDs(8, _platforms, &_numPlatforms) != CL_SUCCESS)
+        return false;
+    if (_numPlatforms > 8)
+        _numPlatforms = 8;
+
+    bool _found = false;
+    for (cl_uint i = 0; i < _numPlatforms && !_found; i++)
+        _found = clGetDeviceIDs(_platforms[i], type, 1, device, NULL) == CL_SUCCESS;
+    for (cl_uint i = 0; i < _numPlatforms && !_found; i++)
+        _found = clGetDeviceIDs(_platforms[i], CL_DEVICE_TYPE_ALL, 1, device, NULL) == CL_SUCCESS;
+    if (!_found)
+        return false;
+
+    char _name[256];
+    clGetDeviceInfo(*device, CL_DEVICE_NAME, sizeof(_name), _name, NULL);
+    printf("Using OpenCL device: %s\n", _name);
+    return true;
+}
+
+void InitializeCells()
+{
+    /**
+     @Desc : Fills the grid with healthy cells and turns at least 25% of them into cancer cells
+     */
+
+    // Initialize all cells as healthy cells
+    for (int i = 0; i < g_windowWidth; i++)
+    {
+        for (int j = 0; j < g_windowHeight; j++)
+        {
+            Cell(i, j) = HEALTHY;
+        }
+    }
+    
+    // Change at least 25% of cells to cancer cells
+    for (int i = 0; i <= g_initialCancer; i++)
+    {
+        int x = rand() % g_windowWidth;
+        int y = rand() % g_windowHeight;
+        if (Cell(x, y) == CANCER)
+            i--;
+        else
+            Cell(x, y) = CANCER;
+    }
+
+    g_population[CANCER] = g_initialCancer + 1;
+    g_population[HEALTHY] = g_totalSize - g_population[CANCER];
+    g_population[MEDICINE] = 0;
+    g_uploadPending = true;
+}
+
+void UpdateOnHost(const cl_uchar *readQuad, cl_uchar *writeQuad)
+{
+    /**
+     @Desc : Reference implementation of the update kernel on the host, used to check the device results
+     @param1 : pointer to read array
+     @param2 : pointer to write array
+     */
+
+    for (int x = 0; x < g_windowWidth; x++) {
+        for (int y = 0; y < g_windowHeight; y++) {
+            int _state = readQuad[x*g_windowHeight + y];
+            if (_state == HEALTHY || _state == CANCER) {
+                int _before = (_state == HEALTHY) ? CANCER : MEDICINE;
+                int _numSurrounded = 0;
+                for (int dx = -1; dx <= 1; dx++) {
+                    for (int dy = -1; dy <= 1; dy++) {
+                        int _nx = x + dx;
+                        int _ny = y + dy;
+                        if ((dx != 0 || dy != 0) && _nx >= 0 && _nx < g_windowWidth && _ny >= 0 && _ny < g_windowHeight &&
+                            readQuad[_nx*g_windowHeight + _ny] == _before)
+                            _numSurrounded++;
+                    }
+                }
+                if (_numSurrounded >= g_threshold)
+                    _state = (_state == HEALTHY) ? CANCER : HEALTHY;
+            }
+            writeQuad[x*g_windowHeight + y] = _state;
+        }
+    }
+}
+
+void InjectOnHost(cl_uchar *quad, int x, int y)
+{
+    /**
+     @Desc : Injects medicine into a cell of a host grid, as the Inject kernel does
+     @param1 : grid to change
+     @param2 : x position of the cell
+     @param3 : y position of the cell
+     */
+
+    // If medicine is injected on a cancer cell,
+    // the medicine is absorbed and the cell turns into a healthy cell
+    if (quad[x*g_windowHeight + y] == CANCER) {
+        quad[x*g_windowHeight + y] = HEALTHY;
+        return;
+    }
+    // If medicine is injected on a healthy or medicine cell,
+    // the medicine is not absorbed and propagates radially outwards by one cell
+    for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, g_windowWidth - 1); nx++) {
+        for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, g_windowHeight - 1); ny++)
+            quad[nx*g_windowHeight + ny] = MEDICINE;
     }
+}
 
-    // Create a GPU compute context
-    gpu_context = clCreateContext(0, 1, &gpu_device_id, NULL, NULL, &err);
-    if (!gpu_context) {
-        printf("Error: Failed to create a compute context!\n");
-        return EXIT_FAILURE;
+void CascadeOnHost(const cl_uchar *readQuad, cl_uchar *writeQuad)
+{
+    /**
+     @Desc : Reference implementation of the heal cascade on the host: floods from every cancer cell that turned
+     healthy through the medicine cells around it
+     @param1 : pointer to the grid before the generation
+     @param2 : pointer to the grid after the generation (healed cells are written in place)
+     */
+
+    std::vector<int> _stack;
+    for (int i = 0; i < g_totalSize; i++) {
+        if (readQuad[i] == CANCER && writeQuad[i] == HEALTHY)
+            _stack.push_back(i);
     }
+    while (!_stack.empty()) {
+        int x = _stack.back() / g_windowHeight;
+        int y = _stack.back() % g_windowHeight;
+        _stack.pop_back();
+        for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, g_windowWidth - 1); nx++) {
+            for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, g_windowHeight - 1); ny++) {
+                if (writeQuad[nx*g_windowHeight + ny] == MEDICINE) {
+                    writeQuad[nx*g_windowHeight + ny] = HEALTHY;
+                    _stack.push_back(nx*g_windowHeight + ny);
+                }
+            }
+        }
+    }
+}
 
-    // Create a GPU command commands
-    gpu_commands = clCreateCommandQueue(gpu_context, gpu_device_id, 0, &err);
-    if (!gpu_commands) {
-        printf("Error: Failed to create a command commands!\n");
-        return EXIT_FAILURE;
+int VerifyWithHost(int generations)
+{
+    /**
+     @Desc : Runs generations on the device and on the host side by side and compares them after each one
+     @param1 : number of generations to compare
+     @return : process exit code (0 if every generation matched)
+     */
+
+    std::vector<cl_uchar> _reference[2];
+    _reference[0].assign(g_cells, g_cells + g_totalSize);
+    _reference[1].resize(g_totalSize);
+    int _current = 0;
+
+    int _batches = 0;
+    for (int g = 0; g < generations; _batches++) {
+        // Inject some medicine now and then so the Inject kernel is exercised as well
+        if (_batches % 10 == 5) {
+            for (int k = 0; k < 3; k++) {
+                int _x = rand() % g_windowWidth;
+                int _y = rand() % g_windowHeight;
+                InjectMedicine(_x, _y);
+                InjectOnHost(&_reference[_current][0], _x, _y);
+            }
+        }
+
+        int _generations = std::min(BatchSize(), generations - g);
+        UpdateWithOpenCL(_generations);
+        ReadBack();
+        for (int k = 0; k < _generations; k++) {
+            UpdateOnHost(&_reference[_current][0], &_reference[1 - _current][0]);
+            if (g_cascade)
+                CascadeOnHost(&_reference[_current][0], &_reference[1 - _current][0]);
+            _current = 1 - _current;
+        }
+        g += _generations;
+
+        const cl_uchar *_device = g_cells;
+        int _count[3] = {0, 0, 0};
+        for (int i = 0; i < g_totalSize; i++) {
+            if (_device[i] != _reference[_current][i]) {
+                printf("Mismatch in generation %d at (%d, %d): device %d, host %d\n", g,
+                    i / g_windowHeight, i % g_windowHeight, _device[i], _reference[_current][i]);
+                return EXIT_FAILURE;
+            }
+            _count[_device[i]]++;
+        }
+        const cl_int *_population = Population();
+        for (int s = 0; s < 3; s++) {
+            if (_population[s] != _count[s]) {
+                printf("Mismatch in generation %d: device counted %d cells of state %d, host %d\n", g, _population[s], s, _count[s]);
+                return EXIT_FAILURE;
+            }
+        }
     }
-    
-    // Create the GPU compute program from the source buffer
-    gpu_program = clCreateProgramWithSource(gpu_context, 1, (const char **) & KernelGPUSource, NULL, &err);
-    if (!gpu_program) {
+    printf("%d generations matched the host reference\n", generations);
+    return 0;
+}
+
+int RunHeadless(int generations, bool stats)
+{
+    /**
+     @Desc : Runs generations without opening a window and prints the throughput. The grid is read back
+     after every batch, as if each batch ended in a frame
+     @param1 : number of generations to run
+     @param2 : print the population after every batch instead of reading back the grid (it never leaves the device)
+     @return : process exit code
+     */
+
+    int _readbacks = 0;
+    auto _start = std::chrono::steady_clock::now();
+    for (int g = 0; g < generations; _readbacks++) {
+        int _generations = std::min(BatchSize(), generations - g);
+        UpdateWithOpenCL(_generations);
+        g += _generations;
+        if (stats) {
+            const cl_int *_population = Population();
+            printf("Generation %d: %d healthy, %d cancer, %d medicine\n", g, _population[HEALTHY], _population[CANCER], _population[MEDICINE]);
+        }
+        else {
+            ReadBack();
+        }
+    }
+    double _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+    printf("%d generations in %.3f s (%.1f generations/s, %d %s)\n", generations, _seconds, generations / _seconds, _readbacks,
+        stats ? "population reads" : "readbacks");
+    if (g_heterogeneous)
+        printf("Split settled at row %d (GPU %d rows, CPU %d rows)\n", g_split, g_split, g_windowHeight - g_split);
+    return 0;
+}
+
+std::string KernelOptions()
+{
+    /**
+     @Desc : Returns the build options that specialise the kernels for the grid size, rule and states of the host,
+     so they cannot disagree with enum cell and the compiler can fold them into the stencil
+     */
+
+    char _options[256];
+    snprintf(_options, sizeof(_options), "-DWIDTH=%d -DHEIGHT=%d -DTHRESH=%d -DCANCER=%d -DHEALTHY=%d -DMEDICINE=%d",
+        g_windowWidth, g_windowHeight, g_threshold, (int)CANCER, (int)HEALTHY, (int)MEDICINE);
+    return _options;
+}
+
+unsigned long long HashString(const std::string &text)
+{
+    /**
+     @Desc : 64-bit FNV-1a hash, used to name cached program binaries
+     @param1 : text to hash
+     */
+
+    unsigned long long _hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < text.size(); i++) {
+        _hash ^= (unsigned char)text[i];
+        _hash *= 1099511628211ULL;
+    }
+    return _hash;
+}
+
+std::string DeviceString(cl_device_id device, cl_device_info param)
+{
+    /**
+     @Desc : Returns a string property of a device
+     @param1 : device to query
+     @param2 : property (e.g. CL_DEVICE_NAME)
+     */
+
+    char _value[1024] = "";
+    clGetDeviceInfo(device, param, sizeof(_value), _value, NULL);
+    return _value;
+}
+
+cl_program BuildProgram(cl_context context, cl_device_id device, const char *source, const char *options)
+{
+    /**
+     @Desc : Creates and builds a program for one device. The binary is cached on disk, keyed by the device name,
+     the driver version and a hash of the source and build options, so later launches skip the compiler.
+     A different source, options or driver gives a different key and the program is built from source again
+     @param1 : context of the device
+     @param2 : device to build for
+     @param3 : program source
+     @param4 : build options
+     @return : the built program (exits on failure)
+     */
+
+    auto _start = std::chrono::steady_clock::now();
+    std::string _key = DeviceString(device, CL_DEVICE_NAME) + "\n" + DeviceString(device, CL_DRIVER_VERSION) + "\n" +
+        std::string(options) + "\n" + source;
+    std::string _path;
+    const char *_home = getenv("HOME");
+    if (g_programCache && _home) {
+        char _name[32];
+        snprintf(_name, sizeof(_name), "/%016llx.bin", HashString(_key));
+        _path = std::string(_home) + "/" + g_programCacheDir + _name;
+    }
+
+    // Try the cached binary first. The file starts with the full key, so a hash collision is not mistaken for a hit
+    cl_program _program = NULL;
+    FILE *_file = _path.empty() ? NULL : fopen(_path.c_str(), "rb");
+    if (_file) {
+        std::vector<char> _contents;
+        char _chunk[65536];
+        size_t _read;
+        while ((_read = fread(_chunk, 1, sizeof(_chunk), _file)) > 0)
+            _contents.insert(_contents.end(), _chunk, _chunk + _read);
+        fclose(_file);
+
+        if (_contents.size() > _key.size() && std::equal(_key.begin(), _key.end(), _contents.begin())) {
+            const unsigned char *_binary = (const unsigned char *)&_contents[_key.size()];
+            size_t _size = _contents.size() - _key.size();
+            cl_int _status;
+            _program = clCreateProgramWithBinary(context, 1, &device, &_size, &_binary, &_status, &err);
+            if (_program && (err != CL_SUCCESS || _status != CL_SUCCESS || clBuildProgram(_program, 1, &device, options, NULL, NULL) != CL_SUCCESS)) {
+                // The driver rejected it, build from source instead
+                clReleaseProgram(_program);
+                _program = NULL;
+            }
+        }
+        if (_program) {
+            printf("Loaded cached program binary in %.1f ms\n",
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count());
+            return _program;
+        }
+    }
+
+    // Create the compute program from the source buffer
+    _program = clCreateProgramWithSource(context, 1, &source, NULL, &err);
+    if (!_program) {
         printf("Error: Failed to create compute program!\n");
-        return EXIT_FAILURE;
+        exit(1);
     }
     
-    // Build the GPU program executable
-    err = clBuildProgram(gpu_program, 0, NULL, NULL, NULL, NULL);
+    // Build the program executable
+    err = clBuildProgram(_program, 1, &device, options, NULL, NULL);
     if (err != CL_SUCCESS) {
         size_t len;
         char buffer[2048];
         
         printf("Error: Failed to build program executable!\n");
-        clGetProgramBuildInfo(gpu_program, gpu_device_id, CL_PROGRAM_BUILD_LOG, sizeof(buffer), buffer, &len);
+        clGetProgramBuildInfo(_program, device, CL_PROGRAM_BUILD_LOG, sizeof(buffer), buffer, &len);
         printf("%s\n", buffer);
         exit(1);
     }
-    
-    // Create the GPU compute kernel in the program we wish to run
-    gpu_kernel = clCreateKernel(gpu_program, "UpdateWithGPU", &err);
-    if (!gpu_kernel || err != CL_SUCCESS) {
-        printf("Error: Failed to create compute kernel!\n");
-        exit(1);
+    printf("Built program from source in %.1f ms\n",
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count());
+
+    // Save the binary for the next launch
+    size_t _size = 0;
+    if (_path.empty() || clGetProgramInfo(_program, CL_PROGRAM_BINARY_SIZES, sizeof(_size), &_size, NULL) != CL_SUCCESS || _size == 0)
+        return _program;
+    std::vector<unsigned char> _binary(_size);
+    unsigned char *_binaries[1] = {&_binary[0]};
+    if (clGetProgramInfo(_program, CL_PROGRAM_BINARIES, sizeof(_binaries), _binaries, NULL) != CL_SUCCESS)
+        return _program;
+    std::string _dir = std::string(_home) + "/.cache";
+    mkdir(_dir.c_str(), 0755);
+    _dir = std::string(_home) + "/" + g_programCacheDir;
+    mkdir(_dir.c_str(), 0755);
+    _file = fopen(_path.c_str(), "wb");
+    if (_file) {
+        fwrite(_key.data(), 1, _key.size(), _file);
+        fwrite(&_binary[0], 1, _size, _file);
+        fclose(_file);
     }
-    
-    // Create the read and write arrays in device memory for our GPU calculation
-    readQuad = clCreateBuffer(gpu_context,  CL_MEM_READ_ONLY,  sizeof(int) * g_totalSize, NULL, NULL);
-    writeQuad = clCreateBuffer(gpu_context, CL_MEM_WRITE_ONLY, sizeof(int) * g_totalSize, NULL, NULL);
-    if (!readQuad || !writeQuad) {
-        printf("Error: Failed to allocate device memory!\n");
-        exit(1);
+    return _program;
+}
+
+double BenchmarkKernel(const char *name, cl_kernel kernel, KernelType type, cl_mem quad[2], size_t cellBytes, void *grid,
+    int generations, double baseline)
+{
+    /**
+     @Desc : Uploads a grid, runs generations with one kernel and reads the result back into the grid.
+     Prints the kernel time per generation and the size and time of the readback
+     @param1 : name to print
+     @param2 : kernel to run
+     @param3 : which of the update kernels it is
+     @param4 : two device grids of the kernel's cell type
+     @param5 : bytes per cell
+     @param6 : host grid of the kernel's cell type (initial grid, receives the result)
+     @param7 : number of generations to run
+     @param8 : kernel time per generation to compare with (0 for the baseline itself)
+     @return : kernel time per generation in seconds
+     */
+
+    size_t _bytes = cellBytes * g_totalSize;
+    clEnqueueWriteBuffer(gpu_commands, quad[0], CL_TRUE, 0, _bytes, grid, 0, NULL, NULL);
+    int _current = 0;
+
+    auto _start = std::chrono::steady_clock::now();
+    for (int g = 0; g < generations; g++) {
+        if (EnqueueKernel(kernel, type, quad[_current], quad[1 - _current], g_windowHeight, NULL, NULL) != CL_SUCCESS) {
+            printf("Error: Failed to execute kernel!\n");
+            exit(1);
+        }
+        _current = 1 - _current;
     }
+    clFinish(gpu_commands);
+    double _kernel = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count() / generations;
 
-    // Connect to a CPU compute device
-    err = clGetDeviceIDs(NULL, CL_DEVICE_TYPE_CPU, 1, &cpu_device_id, NULL);
-    if (err != CL_SUCCESS) {
+    _start = std::chrono::steady_clock::now();
+    clEnqueueReadBuffer(gpu_commands, quad[_current], CL_TRUE, 0, _bytes, grid, 0, NULL, NULL);
+    double _transfer = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+
+    printf("%-24s %8.3f ms per generation", name, _kernel * 1000.0);
+    if (baseline > 0.0)
+        printf(" (%.2fx)", baseline / _kernel);
+    printf(", grid transfer %5d KB in %.3f ms\n", (int)(_bytes / 1024), _transfer * 1000.0);
+    return _kernel;
+}
+
+int RunBenchmark(int generations)
+{
+    /**
+     @Desc : Runs the same generations with every update kernel and prints their kernel time and grid transfer size
+     and time, against the one cell per work item kernel on int cells (built again with -DCELL=int).
+     Checks that all of them end in the same grid
+     @param1 : number of generations to run with each kernel
+     @return : process exit code
+     */
+
+    // The int baseline has its own program and buffers
+    cl_program _intProgram = BuildProgram(gpu_context, gpu_device_id, KernelGPUSource, (KernelOptions() + " -DCELL=int").c_str());
+    cl_kernel _intKernel = clCreateKernel(_intProgram, "UpdateWithGPU", &err);
+    cl_mem _intQuad[2];
+    _intQuad[0] = clCreateBuffer(gpu_context, CL_MEM_READ_WRITE, sizeof(int) * g_totalSize, NULL, NULL);
+    _intQuad[1] = clCreateBuffer(gpu_context, CL_MEM_READ_WRITE, sizeof(int) * g_totalSize, NULL, NULL);
+    if (!_intKernel || !_intQuad[0] || !_intQuad[1]) {
+        printf("Error: Failed to create the int kernel!\n");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<cl_uchar> _initial(&g_quad[0], &g_quad[0] + g_totalSize);
+    std::vector<int> _intGrid(_initial.begin(), _initial.end());
+    double _baseline = BenchmarkKernel("naive kernel, int cells", _intKernel, NAIVE_KERNEL, _intQuad, sizeof(int), &_intGrid[0], generations, 0.0);
+
+    const char *_names[3] = {"naive kernel, uchar cells", "tiled kernel, uchar cells", "vector kernel, uchar16"};
+    cl_kernel _kernels[3] = {gpu_kernel, gpu_tiled_kernel, gpu_vector_kernel};
+    bool _match = true;
+    for (int k = 0; k < 3; k++) {
+        if (k == VECTOR_KERNEL && g_windowHeight % 16 != 0)
+            continue;
+        std::vector<cl_uchar> _grid(_initial);
+        BenchmarkKernel(_names[k], _kernels[k], (KernelType)k, g_deviceQuad, sizeof(cl_uchar), &_grid[0], generations, _baseline);
+        _match = _match && std::equal(_grid.begin(), _grid.end(), _intGrid.begin());
+    }
+    printf("(tiled kernel work groups: %dx%d)\n", (int)g_workGroup[1], (int)g_workGroup[0]);
+
+    clReleaseMemObject(_intQuad[0]);
+    clReleaseMemObject(_intQuad[1]);
+    clReleaseKernel(_intKernel);
+    clReleaseProgram(_intProgram);
+    if (!_match) {
+        printf("Error: the kernels produced different grids!\n");
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
+
+bool SplitDevice(cl_device_id device, cl_device_id *first, cl_device_id *second)
+{
+    /**
+     @Desc : Splits a device into two sub-devices with half of the compute units each, so heterogeneous mode
+     can be run on a single CPU
+     @param1 : device to split
+     @param2 : receives the first sub-device
+     @param3 : receives the second sub-device
+     @return : false if the device cannot be split
+     */
+
+    cl_uint _units = 0;
+    clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(_units), &_units, NULL);
+    if (_units < 2)
+        return false;
+
+    cl_device_partition_property _properties[] = {CL_DEVICE_PARTITION_BY_COUNTS, (cl_device_partition_property)(_units / 2),
+        (cl_device_partition_property)(_units - _units / 2), CL_DEVICE_PARTITION_BY_COUNTS_LIST_END, 0};
+    cl_device_id _devices[2];
+    cl_uint _numDevices = 0;
+    if (clCreateSubDevices(device, _properties, 2, _devices, &_numDevices) != CL_SUCCESS || _numDevices != 2)
+        return false;
+    *first = _devices[0];
+    *second = _devices[1];
+    printf("Split the device into sub-devices of %u and %u compute units\n", _units / 2, _units - _units / 2);
+    return true;
+}
+
+bool ParseNumber(const std::string &text, unsigned long maximum, unsigned long &value)
+{
+    /**
+     @Desc : Reads a command line value made of decimal digits only
+     @param1 : text of the value
+     @param2 : largest accepted value
+     @param3 : receives the value
+     @return : false if the text is empty, holds anything but digits or is larger than maximum
+     */
+
+    if (text.empty() || text.size() > 10 || text.find_first_not_of("0123456789") != std::string::npos)
+        return false;
+    unsigned long long _value = strtoull(text.c_str(), NULL, 10);
+    if (_value > maximum)
+        return false;
+    value = (unsigned long)_value;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    /**
+     @Desc : Main control thread
+     */
+
+    auto _startup = std::chrono::steady_clock::now();
+
+    // Parse the command line options (GLUT ignores the ones it does not know)
+    int _headless = 0;
+    bool _stats = false;
+    int _verify = 0;
+    int _benchmark = 0;
+    g_pacer.SetInterval(1000 / MonitorRefreshRate());
+    for (int i = 1; i < argc; i++) {
+        std::string _arg = argv[i];
+        if (_arg == "--no-pacer")
+            g_pacer.SetEnabled(false);
+        else if (_arg.compare(0, 10, "--refresh=") == 0) {
+            int _interval;
+            if (!FrameIntervalFromRate(_arg.substr(10), _interval)) {
+                printf("Error: --refresh= expects a refresh rate in Hz above 0!\n");
+                return 1;
+            }
+            g_pacer.SetInterval(_interval);
+        }
+        else if (_arg == "--device=cpu")
+            g_deviceType = CL_DEVICE_TYPE_CPU;
+        else if (_arg == "--device=gpu")
+            g_deviceType = CL_DEVICE_TYPE_GPU;
+        else if (_arg.compare(0, 11, "--headless=") == 0) {
+            unsigned long _value;
+            if (!ParseNumber(_arg.substr(11), 0x7FFFFFFF, _value)) {
+                printf("Error: --headless= expects a number of generations!\n");
+                return EXIT_FAILURE;
+            }
+            _headless = (int)_value;
+        }
+        else if (_arg == "--stats")
+            _stats = true;
+        else if (_arg.compare(0, 9, "--verify=") == 0) {
+            unsigned long _value;
+            if (!ParseNumber(_arg.substr(9), 0x7FFFFFFF, _value)) {
+                printf("Error: --verify= expects a number of generations!\n");
+                return EXIT_FAILURE;
+            }
+            _verify = (int)_value;
+        }
+        else if (_arg.compare(0, 12, "--benchmark=") == 0) {
+            unsigned long _value;
+            if (!ParseNumber(_arg.substr(12), 0x7FFFFFFF, _value)) {
+                printf("Error: --benchmark= expects a number of generations!\n");
+                return EXIT_FAILURE;
+            }
+            _benchmark = (int)_value;
+        }
+        else if (_arg == "--kernel=naive")
+            g_kernelType = NAIVE_KERNEL;
+        else if (_arg == "--kernel=tiled")
+            g_kernelType = TILED_KERNEL;
+        else if (_arg == "--kernel=vector")
+            g_kernelType = VECTOR_KERNEL;
+        else if (_arg.compare(0, 12, "--workgroup=") == 0) {
+            // Width (x) first, dimension 0 of the range runs along y
+            std::string _value = _arg.substr(12);
+            size_t _separator = _value.find('x');
+            unsigned long _width, _height;
+            if (_separator == std::string::npos || !ParseNumber(_value.substr(0, _separator), 1024, _width) ||
+                !ParseNumber(_value.substr(_separator + 1), 1024, _height) || _width < 1 || _height < 1) {
+                printf("Error: --workgroup= expects WxH with sides from 1 to 1024!\n");
+                return EXIT_FAILURE;
+            }
+            g_workGroup[1] = _width;
+            g_workGroup[0] = _height;
+        }
+        else if (_arg == "--no-program-cache")
+            g_programCache = false;
+        else if (_arg == "--no-zero-copy")
+            g_zeroCopy = false;
+        else if (_arg == "--hetero")
+            g_heterogeneous = true;
+        else if (_arg == "--cascade")
+            g_cascade = true;
+        else if (_arg == "--batch=auto")
+            g_adaptiveBatch = true;
+        else if (_arg.compare(0, 8, "--batch=") == 0) {
+            unsigned long _value;
+            if (!ParseNumber(_arg.substr(8), g_maxBatch, _value) || _value < 1) {
+                printf("Error: --batch= expects auto or a number of generations from 1 to %d!\n", g_maxBatch);
+                return EXIT_FAILURE;
+            }
+            g_batchSize = (int)_value;
+        }
+        else if (_arg.compare(0, 7, "--size=") == 0) {
+            std::string _value = _arg.substr(7);
+            size_t _separator = _value.find('x');
+            unsigned long _width, _height;
+            if (_separator == std::string::npos || !ParseNumber(_value.substr(0, _separator), 16384, _width) ||
+                !ParseNumber(_value.substr(_separator + 1), 16384, _height)) {
+                printf("Error: --size= expects WxH with sides of at most 16384 cells!\n");
+                return EXIT_FAILURE;
+            }
+            g_windowWidth = (int)_width;
+            g_windowHeight = (int)_height;
+        }
+        else if (_arg.compare(0, 12, "--threshold=") == 0) {
+            // A cell has 8 neighbours
+            unsigned long _value;
+            if (!ParseNumber(_arg.substr(12), 8, _value)) {
+                printf("Error: --threshold= expects a number of neighbours from 0 to 8!\n");
+                return EXIT_FAILURE;
+            }
+            g_threshold = (int)_value;
+        }
+        else if (_arg.compare(0, 14, "--profile-csv=") == 0)
+            g_profileCsv = _arg.substr(14);
+    }
+
+    // Size the grid
+    if (g_windowWidth < 1 || g_windowHeight < 2 * g_minBand) {
+        printf("Error: The grid must be at least 1x%d cells!\n", 2 * g_minBand);
+        return EXIT_FAILURE;
+    }
+    if (g_cascade && g_heterogeneous) {
+        printf("Error: The heal cascade is not supported in heterogeneous mode!\n");
+        return EXIT_FAILURE;
+    }
+    if (g_kernelType == VECTOR_KERNEL && g_windowHeight % 16 != 0) {
+        printf("Error: The vector kernel needs a grid height that is a multiple of 16!\n");
+        return EXIT_FAILURE;
+    }
+    g_totalSize = g_windowWidth * g_windowHeight;
+    g_initialCancer = g_totalSize * 0.26;
+    g_quad.resize(g_totalSize);
+    g_cells = &g_quad[0];
+    g_split = g_windowHeight / 2;
+
+    // Connect to a compute device for the simulation
+    if (!SelectDevice(g_deviceType, &gpu_device_id)) {
         printf("Error: Failed to create a device group!\n");
         return EXIT_FAILURE;
     }
-    
-    // Create a CPU compute context
-    cpu_context = clCreateContext(0, 1, &cpu_device_id, NULL, NULL, &err);
-    if (!cpu_context) {
+
+    if (g_heterogeneous) {
+        // Connect to a CPU compute device for the second band
+        if (!SelectDevice(CL_DEVICE_TYPE_CPU, &cpu_device_id)) {
+            printf("Error: Failed to create a device group!\n");
+            return EXIT_FAILURE;
+        }
+        // Without a separate GPU, both bands run on halves of the same device
+        if (cpu_device_id == gpu_device_id && !SplitDevice(gpu_device_id, &gpu_device_id, &cpu_device_id)) {
+            printf("Error: Failed to create sub-devices!\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Create a GPU compute context
+    gpu_context = clCreateContext(0, 1, &gpu_device_id, NULL, NULL, &err);
+    if (!gpu_context) {
         printf("Error: Failed to create a compute context!\n");
         return EXIT_FAILURE;
     }
 
-    // Create a CPU command commands
-    cpu_commands = clCreateCommandQueue(cpu_context, cpu_device_id, 0, &err);
-    if (!cpu_commands) {
+    // Create a GPU command commands. Profiling times every phase (and balances the bands in heterogeneous mode)
+    cl_command_queue_properties _properties = CL_QUEUE_PROFILING_ENABLE;
+    gpu_commands = clCreateCommandQueue(gpu_context, gpu_device_id, _properties, &err);
+    if (!gpu_commands) {
         printf("Error: Failed to create a command commands!\n");
         return EXIT_FAILURE;
     }
-
-    // Create the CPU compute program from the source buffer
-    cpu_program = clCreateProgramWithSource(cpu_context, 1, (const char **) & KernelCPUSource, NULL, &err);
-    if (!cpu_program) {
-        printf("Error: Failed to create compute program!\n");
-        return EXIT_FAILURE;
+    
+    // Create and build the GPU compute program (or load it from the binary cache)
+    gpu_program = BuildProgram(gpu_context, gpu_device_id, KernelGPUSource, KernelOptions().c_str());
+    
+    // Create the GPU compute kernel in the program we wish to run
+    gpu_kernel = clCreateKernel(gpu_program, "UpdateWithGPU", &err);
+    if (!gpu_kernel || err != CL_SUCCESS) {
+        printf("Error: Failed to create compute kernel!\n");
+        exit(1);
     }
     
-    // Build the CPU program executable
-    err = clBuildProgram(cpu_program, 0, NULL, NULL, NULL, NULL);
+    // Get the maximum work group size for executing the kernel on the device
+    err = clGetKernelWorkGroupInfo(gpu_kernel, gpu_device_id, CL_KERNEL_WORK_GROUP_SIZE, sizeof(local), &local, NULL);
     if (err != CL_SUCCESS) {
-        size_t len;
-        char buffer[2048];
-        
-        printf("Error: Failed to build program executable!\n");
-        clGetProgramBuildInfo(cpu_program, cpu_device_id, CL_PROGRAM_BUILD_LOG, sizeof(buffer), buffer, &len);
-        printf("%s\n", buffer);
+        printf("Error: Failed to retrieve kernel work group info! %d\n", err);
+        exit(1);
+    }
+    // The work group size has to divide the number of cells
+    while (g_totalSize % local != 0)
+        local /= 2;
+
+    // Create the tiled GPU compute kernel and check that its work group shape fits on the device
+    gpu_tiled_kernel = clCreateKernel(gpu_program, "UpdateWithGPUTiled", &err);
+    if (!gpu_tiled_kernel || err != CL_SUCCESS) {
+        printf("Error: Failed to create compute kernel!\n");
+        exit(1);
+    }
+    size_t _maxTiled;
+    err = clGetKernelWorkGroupInfo(gpu_tiled_kernel, gpu_device_id, CL_KERNEL_WORK_GROUP_SIZE, sizeof(_maxTiled), &_maxTiled, NULL);
+    if (err != CL_SUCCESS || g_workGroup[0] == 0 || g_workGroup[1] == 0 || g_workGroup[0] * g_workGroup[1] > _maxTiled) {
+        printf("Error: Work group of %dx%d cells is not supported by the device (at most %d work items)!\n",
+            (int)g_workGroup[1], (int)g_workGroup[0], (int)_maxTiled);
+        exit(1);
+    }
+    err = clSetKernelArg(gpu_tiled_kernel, 2, sizeof(cl_uchar) * (g_workGroup[0] + 2) * (g_workGroup[1] + 2), NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to set kernel arguments! %d\n", err);
         exit(1);
     }
     
-    // Create the CPU compute kernel in the program we wish to run
-    cpu_kernel = clCreateKernel(cpu_program, "UpdateWithCPU", &err);
-    if (!cpu_kernel || err != CL_SUCCESS) {
+    // Create the vector GPU compute kernel
+    gpu_vector_kernel = clCreateKernel(gpu_program, "UpdateWithGPUVector", &err);
+    if (!gpu_vector_kernel || err != CL_SUCCESS) {
         printf("Error: Failed to create compute kernel!\n");
         exit(1);
     }
     
-    // Create the read and write arrays in device memory for our CPU calculation
-    colorQuad = clCreateBuffer(cpu_context,  CL_MEM_READ_ONLY,  sizeof(int) * g_totalSize, NULL, NULL);
-    if (!colorQuad) {
+    // Zero-copy only pays off when the device works on host memory. The two bands of heterogeneous mode
+    // live on different devices, so they are still read back row by row
+    cl_bool _unified = CL_FALSE;
+    clGetDeviceInfo(gpu_device_id, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(_unified), &_unified, NULL);
+    g_zeroCopy = g_zeroCopy && _unified && !g_heterogeneous;
+    printf("Zero-copy grid %s\n", g_zeroCopy ? "enabled" : "disabled");
+
+    // Create the heal cascade kernel and its flag, it runs on the work groups of the tiled kernel
+    if (g_cascade) {
+        gpu_cascade_kernel = clCreateKernel(gpu_program, "HealCascade", &err);
+        g_changedBuffer = clCreateBuffer(gpu_context, CL_MEM_READ_WRITE, sizeof(cl_int), NULL, NULL);
+        if (!gpu_cascade_kernel || !g_changedBuffer) {
+            printf("Error: Failed to create compute kernel!\n");
+            exit(1);
+        }
+        err = clGetKernelWorkGroupInfo(gpu_cascade_kernel, gpu_device_id, CL_KERNEL_WORK_GROUP_SIZE, sizeof(_maxTiled), &_maxTiled, NULL);
+        if (err != CL_SUCCESS || g_workGroup[0] * g_workGroup[1] > _maxTiled) {
+            printf("Error: Work group of %dx%d cells is not supported by the device (at most %d work items)!\n",
+                (int)g_workGroup[1], (int)g_workGroup[0], (int)_maxTiled);
+            exit(1);
+        }
+        err = clSetKernelArg(gpu_cascade_kernel, 2, sizeof(cl_uchar) * (g_workGroup[0] + 2) * (g_workGroup[1] + 2), NULL);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to set kernel arguments! %d\n", err);
+            exit(1);
+        }
+    }
+
+    // Create the GPU injection kernel and its buffer
+    gpu_inject_kernel = clCreateKernel(gpu_program, "Inject", &err);
+    g_injectionBuffer = clCreateBuffer(gpu_context, CL_MEM_READ_ONLY, sizeof(cl_int) * 3 * g_maxInjections, NULL, NULL);
+    if (!gpu_inject_kernel || !g_injectionBuffer) {
+        printf("Error: Failed to create compute kernel!\n");
+        exit(1);
+    }
+
+    // Create the GPU counts buffer
+    g_countsBuffer = clCreateBuffer(gpu_context, CL_MEM_READ_WRITE, sizeof(cl_int) * 3, NULL, NULL);
+    if (!g_countsBuffer) {
         printf("Error: Failed to allocate device memory!\n");
         exit(1);
     }
 
-    // initialize
-    glutInit(&argc, argv);
-    glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH );
-    glutInitWindowSize(g_windowWidth, g_windowHeight);
-    glutCreateWindow("2D Cell Growth Simulation");
+    // Create the two grid buffers in device memory for our GPU calculation (both are read and written)
+    cl_mem_flags _flags = CL_MEM_READ_WRITE | (g_zeroCopy ? CL_MEM_ALLOC_HOST_PTR : 0);
+    g_deviceQuad[0] = clCreateBuffer(gpu_context, _flags, sizeof(cl_uchar) * g_totalSize, NULL, NULL);
+    g_deviceQuad[1] = clCreateBuffer(gpu_context, _flags, sizeof(cl_uchar) * g_totalSize, NULL, NULL);
+    if (!g_deviceQuad[0] || !g_deviceQuad[1]) {
+        printf("Error: Failed to allocate device memory!\n");
+        exit(1);
+    }
+
+    // The CPU device updates the second band in heterogeneous mode
+    if (g_heterogeneous) {
+        // Create a CPU compute context
+        cpu_context = clCreateContext(0, 1, &cpu_device_id, NULL, NULL, &err);
+        if (!cpu_context) {
+            printf("Error: Failed to create a compute context!\n");
+            return EXIT_FAILURE;
+        }
+
+        // Create a CPU command commands
+        cpu_commands = clCreateCommandQueue(cpu_context, cpu_device_id, _properties, &err);
+        if (!cpu_commands) {
+            printf("Error: Failed to create a command commands!\n");
+            return EXIT_FAILURE;
+        }
+
+        // Create and build the CPU compute program (or load it from the binary cache)
+        cpu_program = BuildProgram(cpu_context, cpu_device_id, KernelCPUSource, KernelOptions().c_str());
     
-    // Initialize all cells as healthy cells
-    for (int i = 0; i < 1024; i++)
-    {
-        for (int j = 0; j < 768; j++)
-        {
-            g_quad[i][j] = HEALTHY;
+        // Create the CPU compute kernel in the program we wish to run
+        cpu_kernel = clCreateKernel(cpu_program, "UpdateWithCPU", &err);
+        if (!cpu_kernel || err != CL_SUCCESS) {
+            printf("Error: Failed to create compute kernel!\n");
+            exit(1);
         }
-    }
     
+        // Create the CPU injection kernel and its buffer
+        cpu_inject_kernel = clCreateKernel(cpu_program, "Inject", &err);
+        g_cpuInjectionBuffer = clCreateBuffer(cpu_context, CL_MEM_READ_ONLY, sizeof(cl_int) * 3 * g_maxInjections, NULL, NULL);
+        if (!cpu_inject_kernel || !g_cpuInjectionBuffer) {
+            printf("Error: Failed to create compute kernel!\n");
+            exit(1);
+        }
+
+        // Create the CPU counts buffer
+        g_cpuCountsBuffer = clCreateBuffer(cpu_context, CL_MEM_READ_WRITE, sizeof(cl_int) * 3, NULL, NULL);
+        if (!g_cpuCountsBuffer) {
+            printf("Error: Failed to allocate device memory!\n");
+            exit(1);
+        }
+
+        // Create the two grid buffers in device memory for our CPU calculation
+        g_cpuQuad[0] = clCreateBuffer(cpu_context, CL_MEM_READ_WRITE, sizeof(cl_uchar) * g_totalSize, NULL, NULL);
+        g_cpuQuad[1] = clCreateBuffer(cpu_context, CL_MEM_READ_WRITE, sizeof(cl_uchar) * g_totalSize, NULL, NULL);
+        if (!g_cpuQuad[0] || !g_cpuQuad[1]) {
+            printf("Error: Failed to allocate device memory!\n");
+            exit(1);
+        }
+    }
+
+    // Compare with --no-program-cache to see what the binary cache saves
+    printf("OpenCL ready %.1f ms after launch\n", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _startup).count());
+
+    // The phase timings are written however the program ends
+    atexit(WriteProfileCsv);
+
     // Initialize random seed
     srand((int)time(NULL));
-    
-    
-    // Change at least 25% of cells to cancer cells
-    for (int i = 0; i <= g_initialCancer; i++)
-    {
-        int x = rand() % 1024;
-        int y = rand() % 768;
-        if (g_quad[x][y] == CANCER)
-            i--;
-        else
-            g_quad[x][y] = CANCER;
-    }
+    InitializeCells();
+
+    // Runs without a window, for benchmarking and for checking the kernel on a CPU device
+    if (_verify > 0)
+        return VerifyWithHost(_verify);
+    if (_benchmark > 0)
+        return RunBenchmark(_benchmark);
+    if (_headless > 0)
+        return RunHeadless(_headless, _stats);
+
+    // initialize
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH );
+    glutInitWindowSize(std::min(g_windowWidth, 1024), std::min(g_windowHeight, 768));
+    glutCreateWindow("2D Cell Growth Simulation");
     
     glutDisplayFunc(Display);
-    glutIdleFunc(Display);
+    // Redraws are requested by RequestRedisplay, the idle function is only used with the pacer off
+    if (!g_pacer.Enabled())
+        glutIdleFunc(Display);
     glutMouseFunc(MouseClicks);
     glutKeyboardFunc(Keyboard);
     glutTimerFunc(g_updateTime, Update, 0);
     Initialize();
     
+    g_pacer.ResetStats();
     glutMainLoop();
 
     // Shutdown and cleanup
-    clReleaseMemObject(readQuad);
-    clReleaseMemObject(writeQuad);
+    clReleaseMemObject(g_deviceQuad[0]);
+    clReleaseMemObject(g_deviceQuad[1]);
     clReleaseProgram(gpu_program);
-    clReleaseProgram(cpu_program);
     clReleaseKernel(gpu_kernel);
-    clReleaseKernel(cpu_kernel);
+    clReleaseKernel(gpu_tiled_kernel);
+    clReleaseKernel(gpu_vector_kernel);
     clReleaseCommandQueue(gpu_commands);
-    clReleaseCommandQueue(cpu_commands);
     clReleaseContext(gpu_context);
-    clReleaseContext(cpu_context);
+    // The CPU device objects only exist in heterogeneous mode
+    if (g_heterogeneous) {
+        clReleaseMemObject(g_cpuQuad[0]);
+        clReleaseMemObject(g_cpuQuad[1]);
+        clReleaseProgram(cpu_program);
+        clReleaseKernel(cpu_kernel);
+        clReleaseCommandQueue(cpu_commands);
+        clReleaseContext(cpu_context);
+    }
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,354 @@
+#include "Autotune.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+struct Candidate
+{
+	std::string backend;
+	BackendOptions options;
+};
+
+std::string HostName()
+{
+	char _name[256] = "unknown";
+#ifdef _WIN32
+	DWORD _size = sizeof(_name);
+	GetComputerNameA(_name, &_size);
+#else
+	gethostname(_name, sizeof(_name));
+	_name[sizeof(_name) - 1] = '\0';
+#endif
+	return _name;
+}
+
+std::string CpuModel()
+{
+	/**
+	@Desc : Returns the brand string of the CPU (cpuid leaves 0x80000002 to 0x80000004), "unknown" if there is none
+	*/
+
+	unsigned int _brand[12] = { 0 };
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+	int _info[4];
+	__cpuid(_info, 0x80000000);
+	if ((unsigned int)_info[0] >= 0x80000004) {
+		for (int i = 0; i < 3; i++) {
+			__cpuid(_info, 0x80000002 + i);
+			memcpy(&_brand[i * 4], _info, sizeof(_info));
+		}
+	}
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	if (__get_cpuid_max(0x80000000, NULL) >= 0x80000004) {
+		for (int i = 0; i < 3; i++)
+			__get_cpuid(0x80000002 + i, &_brand[i * 4], &_brand[i * 4 + 1], &_brand[i * 4 + 2], &_brand[i * 4 + 3]);
+	}
+#endif
+	std::string _model((const char *)_brand, strnlen((const char *)_brand, sizeof(_brand)));
+	// Some CPUs pad the string with leading spaces
+	std::size_t _first = _model.find_first_not_of(' ');
+	if (_first == std::string::npos)
+		return "unknown";
+	return _model.substr(_first);
+}
+
+std::string DefaultTuneCachePath()
+{
+	return "autotune-" + HostName() + ".cache";
+}
+
+std::string RunningBinaryPath(const std::string &fallback)
+{
+	/**
+	@Desc : Returns the path of the running binary. argv[0] is only a name when the binary was found through PATH,
+	so the operating system is asked first
+	@param1 : path to use when the operating system cannot tell (argv[0])
+	*/
+
+#ifdef _WIN32
+	char _path[MAX_PATH];
+	DWORD _length = GetModuleFileNameA(NULL, _path, MAX_PATH);
+	if (_length > 0 && _length < MAX_PATH)
+		return std::string(_path, _length);
+#elif defined(__linux__)
+	char _path[4096];
+	ssize_t _length = readlink("/proc/self/exe", _path, sizeof(_path));
+	if (_length > 0 && _length < (ssize_t)sizeof(_path))
+		return std::string(_path, _length);
+#endif
+	return fallback;
+}
+
+std::string TuneKey(int width, int height, bool cascade, const std::string &binaryPath)
+{
+	/**
+	@Desc : Builds the key a cached result must match: the host, its hardware (CPU model, cores, OpenCL device),
+	the binary (size and modification time, so a rebuild tunes again), and the area being tuned for
+	@param1 : width of the area
+	@param2 : height of the area
+	@param3 : heal cascade on
+	@param4 : path of the running binary as given on the command line (argv[0])
+	*/
+
+	struct stat _stat;
+	std::string _binary = "unknown";
+	if (stat(RunningBinaryPath(binaryPath).c_str(), &_stat) == 0)
+		_binary = std::to_string((long long)_stat.st_size) + "-" + std::to_string((long long)_stat.st_mtime);
+
+	return "host=" + HostName() + "\n" +
+		"cpu=" + CpuModel() + "\n" +
+		"cores=" + std::to_string((long long)std::thread::hardware_concurrency()) + "\n" +
+		"opencl=" + OpenClDeviceName() + "\n" +
+		"binary=" + _binary + "\n" +
+		"size=" + std::to_string((long long)width) + "x" + std::to_string((long long)height) + "\n" +
+		"cascade=" + (cascade ? "1" : "0") + "\n";
+}
+
+std::string Describe(const Candidate &candidate)
+{
+	std::string _text = candidate.backend;
+	if (candidate.options.threads > 0)
+		_text += " threads=" + std::to_string((long long)candidate.options.threads);
+	if (candidate.options.tile > 0)
+		_text += " tile=" + std::to_string((long long)candidate.options.tile);
+	if (candidate.options.workGroup > 0)
+		_text += " work-group=" + std::to_string((long long)candidate.options.workGroup);
+	return _text;
+}
+
+std::vector<Candidate> Candidates(bool cascade)
+{
+	/**
+	@Desc : Lists the configurations worth trying on this build and machine
+	@param1 : heal cascade on (the swar and OpenCL backends cannot run it)
+	*/
+
+	std::vector<Candidate> _candidates;
+	Candidate _candidate;
+	_candidate.options.cascade = cascade;
+
+	// Thread counts in powers of two up to one per core
+	int _cores = (int)std::thread::hardware_concurrency();
+	if (_cores < 1)
+		_cores = 4;
+	_candidate.backend = "thread";
+	for (int t = 1; ; t *= 2) {
+		_candidate.options.threads = t < _cores ? t : _cores;
+		_candidates.push_back(_candidate);
+		if (t >= _cores)
+			break;
+	}
+	_candidate.options.threads = 0;
+
+	// Tiles of 0 keep the backend's default (grain 1 for TBB, 16x32 blocks for CUDA)
+	const int _tiles[] = { 0, 16, 64, 256 };
+	if (BackendBuiltIn("tbb")) {
+		_candidate.backend = "tbb";
+		for (int i = 0; i < 4; i++) {
+			_candidate.options.tile = _tiles[i];
+			_candidates.push_back(_candidate);
+		}
+	}
+	_candidate.backend = "cuda-cpu";
+	for (int i = 0; i < 4; i++) {
+		_candidate.options.tile = _tiles[i];
+		_candidates.push_back(_candidate);
+	}
+	_candidate.options.tile = 0;
+
+	// The swar and OpenCL backends have no heal cascade, they are only tried with --no-cascade
+	if (cascade)
+		printf("Autotune: skipping swar and opencl, they do not run the heal cascade (--no-cascade)\n");
+
+	// Bitplanes on one thread, and with threads when there are several cores
+	if (!cascade) {
+		_candidate.backend = "swar";
+		_candidate.options.threads = 1;
+		_candidates.push_back(_candidate);
+		if (_cores > 1) {
+			_candidate.options.threads = _cores;
+			_candidates.push_back(_candidate);
+		}
+		_candidate.options.threads = 0;
+	}
+
+	if (!cascade && BackendBuiltIn("opencl") && !OpenClDeviceName().empty()) {
+		const int _workGroups[] = { 0, 64, 128, 256 };
+		_candidate.backend = "opencl";
+		for (int i = 0; i < 4; i++) {
+			_candidate.options.workGroup = _workGroups[i];
+			_candidates.push_back(_candidate);
+		}
+	}
+	return _candidates;
+}
+
+double Benchmark(const Candidate &candidate, const Grid &grid, double seconds)
+{
+	/**
+	@Desc : Measures the generations per second of one configuration. The batch doubles until the time is used,
+	but never beyond what the rest of the time fits at the rate so far, and every batch ends with a read back
+	so asynchronous backends are timed to completion
+	@param1 : configuration to run
+	@param2 : area to start from
+	@param3 : time to spend
+	@return : generations per second, 0 if the backend could not be created
+	*/
+
+	Backend *_backend = CreateBackend(candidate.backend, candidate.options);
+	if (!_backend)
+		return 0;
+	Grid _scratch;
+	_backend->SetGrid(grid);
+	// Warm up (thread creation, program build)
+	_backend->Run(1);
+	_backend->GetGrid(_scratch);
+
+	auto _start = std::chrono::steady_clock::now();
+	int _generations = 0;
+	double _elapsed = 0;
+	int _batch = 1;
+	while (_elapsed < seconds) {
+		_backend->Run(_batch);
+		_backend->GetGrid(_scratch);
+		_generations += _batch;
+		_elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+		// A doubled last batch could take as long as everything before it
+		double _fits = (seconds - _elapsed) * _generations / _elapsed;
+		_batch = _batch * 2 < _fits ? _batch * 2 : (_fits > 1 ? (int)_fits : 1);
+	}
+	delete _backend;
+	return _generations / _elapsed;
+}
+
+bool ReadTuneCache(const std::string &path, const std::string &key, TuneResult &result)
+{
+	/**
+	@Desc : Loads a cached result. The file starts with the full key, so a result from another host, hardware,
+	binary or area is ignored
+	@param1 : cache file
+	@param2 : key the file must start with
+	@param3 : receives the cached result
+	*/
+
+	std::ifstream _file(path.c_str());
+	if (!_file)
+		return false;
+	std::stringstream _contents;
+	_contents << _file.rdbuf();
+	std::string _text = _contents.str();
+	if (_text.compare(0, key.size(), key) != 0)
+		return false;
+
+	// One name=value per line after the key
+	std::istringstream _lines(_text.substr(key.size()));
+	std::string _line;
+	int _fields = 0;
+	while (std::getline(_lines, _line)) {
+		std::size_t _separator = _line.find('=');
+		if (_separator == std::string::npos)
+			continue;
+		std::string _name = _line.substr(0, _separator);
+		std::string _value = _line.substr(_separator + 1);
+		_fields++;
+		if (_name == "backend")
+			result.backend = _value;
+		else if (_name == "threads" || _name == "tile" || _name == "workgroup") {
+			// A truncated or hand-edited file is a cache miss, not a reason to stop
+			char *_end;
+			long _number = strtol(_value.c_str(), &_end, 10);
+			if (_value.empty() || *_end != '\0' || _number < 0 || _number > 65536)
+				return false;
+			int &_option = _name == "threads" ? result.options.threads : _name == "tile" ? result.options.tile : result.options.workGroup;
+			_option = (int)_number;
+		}
+		else if (_name == "rate") {
+			char *_end;
+			result.generationsPerSecond = strtod(_value.c_str(), &_end);
+			if (_value.empty() || *_end != '\0')
+				return false;
+		}
+		else
+			_fields--;
+	}
+	return _fields == 5 && BackendBuiltIn(result.backend);
+}
+
+void WriteTuneCache(const std::string &path, const std::string &key, const TuneResult &result)
+{
+	std::ofstream _file(path.c_str());
+	if (!_file) {
+		printf("Warning: Could not write the autotune cache %s\n", path.c_str());
+		return;
+	}
+	_file << key << "backend=" << result.backend << "\nthreads=" << result.options.threads << "\ntile=" << result.options.tile <<
+		"\nworkgroup=" << result.options.workGroup << "\nrate=" << result.generationsPerSecond << "\n";
+}
+
+TuneResult Autotune(int width, int height, bool cascade, const std::string &binaryPath, const std::string &cachePath,
+	bool retune, double budgetSeconds)
+{
+	/**
+	@Desc : Picks the fastest configuration for an area. A cached result is reused until the host, hardware,
+	binary or area changes, otherwise every candidate gets an equal share of the time budget
+	@param1 : width of the area
+	@param2 : height of the area
+	@param3 : heal cascade on
+	@param4 : path of the running binary as given on the command line (argv[0])
+	@param5 : cache file
+	@param6 : ignore the cache and benchmark again
+	@param7 : total benchmarking time in seconds
+	*/
+
+	std::string _key = TuneKey(width, height, cascade, binaryPath);
+	TuneResult _cached;
+	_cached.options.cascade = cascade;
+	if (!retune && ReadTuneCache(cachePath, _key, _cached)) {
+		printf("Autotune: using cached %s backend (%.1f generations/s)\n", _cached.backend.c_str(), _cached.generationsPerSecond);
+		return _cached;
+	}
+
+	TuneResult _best;
+
+	// Tune on a fixed area so runs are comparable, the rule does the same work whatever the seed
+	Grid _grid(width, height);
+	InitializeCells(_grid, 1);
+	std::vector<Candidate> _candidates = Candidates(cascade);
+	double _share = budgetSeconds / _candidates.size();
+	for (std::size_t i = 0; i < _candidates.size(); i++) {
+		double _rate = Benchmark(_candidates[i], _grid, _share);
+		printf("Autotune: %s: %.1f generations/s\n", Describe(_candidates[i]).c_str(), _rate);
+		if (_rate > _best.generationsPerSecond) {
+			_best.backend = _candidates[i].backend;
+			_best.options = _candidates[i].options;
+			_best.generationsPerSecond = _rate;
+		}
+	}
+	if (_best.backend.empty()) {
+		printf("Error: No backend could be benchmarked!\n");
+		exit(1);
+	}
+	Candidate _picked;
+	_picked.backend = _best.backend;
+	_picked.options = _best.options;
+	printf("Autotune: picked %s\n", Describe(_picked).c_str());
+	WriteTuneCache(cachePath, _key, _best);
+	return _best;
+}
@@ -0,0 +1,27 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <string>
+#include "Backend.h"
+
+struct TuneResult
+{
+	/**
+	@Desc : Fastest configuration found by the autotuner
+	*/
+
+	std::string backend;
+	BackendOptions options;
+	double generationsPerSecond;
+
+	TuneResult() : generationsPerSecond(0) { }
+};
+
+// Picks the fastest backend, thread count, tile and work-group size for an area, from the cache file
+// when it was written on the same host, hardware and binary, otherwise by benchmarking the candidates
+TuneResult Autotune(int width, int height, bool cascade, const std::string &binaryPath, const std::string &cachePath,
+	bool retune, double budgetSeconds);
+// Default cache file of this host (autotune-<host name>.cache in the working directory)
+std::string DefaultTuneCachePath();
+
+#endif
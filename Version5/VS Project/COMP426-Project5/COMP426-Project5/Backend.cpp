@@ -0,0 +1,85 @@
+#include "Backend.h"
+
+void HostBackend::SetGrid(const Grid &grid)
+{
+	/**
+	@Desc : Replaces the area
+	@param1 : new area
+	*/
+
+	grids[0] = grid;
+	grids[1] = grid;
+	current = 0;
+	int _counts[3];
+	CountCells(grid, _counts);
+	medicine = _counts[MEDICINE];
+}
+
+void HostBackend::Run(int generations)
+{
+	/**
+	@Desc : Runs generations, swapping the two grids after each one
+	@param1 : number of generations to run
+	*/
+
+	for (int g = 0; g < generations; g++) {
+		Generation(grids[current], grids[1 - current]);
+		if (options.cascade && medicine > 0)
+			medicine -= HealCascade(grids[current], grids[1 - current]);
+		current = 1 - current;
+	}
+}
+
+void HostBackend::GetGrid(Grid &grid)
+{
+	/**
+	@Desc : Copies the latest generation
+	@param1 : receives the area
+	*/
+
+	grid = grids[current];
+}
+
+Backend *CreateBackend(const std::string &name, const BackendOptions &options)
+{
+	/**
+	@Desc : Creates a backend by name
+	@param1 : name given to --backend=
+	@param2 : settings of the backend
+	*/
+
+	if (name == "thread")
+		return CreateThreadBackend(options);
+	if (name == "tbb")
+		return CreateTbbBackend(options);
+	if (name == "opencl")
+		return CreateOpenClBackend(options);
+	if (name == "cuda-cpu")
+		return CreateCudaCpuBackend(options);
+	if (name == "swar")
+		return CreateBitplaneBackend(options);
+	return NULL;
+}
+
+const char *BackendNames()
+{
+	return "thread|tbb|opencl|cuda-cpu|swar";
+}
+
+bool BackendBuiltIn(const std::string &name)
+{
+	/**
+	@Desc : Tells whether a backend was compiled in (TBB and OpenCL are optional)
+	@param1 : name given to --backend=
+	*/
+
+#ifndef ENGINE_WITH_TBB
+	if (name == "tbb")
+		return false;
+#endif
+#ifndef ENGINE_WITH_OPENCL
+	if (name == "opencl")
+		return false;
+#endif
+	return name == "thread" || name == "tbb" || name == "opencl" || name == "cuda-cpu" || name == "swar";
+}
@@ -0,0 +1,88 @@
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include <string>
+#include "Rules.h"
+
+struct BackendOptions
+{
+	/**
+	@Desc : Settings shared by the backends (each one uses those that apply to it)
+	*/
+
+	// Worker threads of the CPU backends (0 for one per core)
+	int threads;
+	// Edge of the square tiles the area is split into (TBB grain, CUDA block), 0 for the backend's default
+	int tile;
+	// OpenCL work-group size, 0 to let the runtime choose
+	int workGroup;
+	// Run the heal cascade after every generation, as Versions 1 to 4 do (--no-cascade turns it off)
+	bool cascade;
+
+	BackendOptions() : threads(0), tile(0), workGroup(0), cascade(true) { }
+};
+
+class Backend
+{
+	/**
+	@Desc : One way of running generations (a parallel strategy of one of the earlier versions).
+	A backend owns its copy of the area, which may live in device memory
+	*/
+
+public:
+	virtual ~Backend() { }
+
+	// Name given to --backend=
+	virtual const char *Name() const = 0;
+	// Replaces the area (after initialisation or when the host changed cells)
+	virtual void SetGrid(const Grid &grid) = 0;
+	// Runs generations on the area
+	virtual void Run(int generations) = 0;
+	// Copies the latest generation into grid
+	virtual void GetGrid(Grid &grid) = 0;
+};
+
+class HostBackend : public Backend
+{
+	/**
+	@Desc : Backend whose area lives in host memory. Generations ping-pong between two grids,
+	the derived class only computes one generation from the other
+	*/
+
+protected:
+	BackendOptions options;
+	Grid grids[2];
+	// Index of the grid holding the latest generation
+	int current;
+	// Medicine cells in the area. Only injections add them and only the cascade removes them,
+	// so the cascade (a full scan of the area) is skipped while there are none
+	int medicine;
+
+	// Computes the next generation of read into write
+	virtual void Generation(const Grid &read, Grid &write) = 0;
+
+public:
+	HostBackend(const BackendOptions &options) : options(options), current(0), medicine(0) { }
+
+	void SetGrid(const Grid &grid);
+	void Run(int generations);
+	void GetGrid(Grid &grid);
+};
+
+// Factories of the backends, NULL if the backend was not built in or cannot run with these options
+Backend *CreateThreadBackend(const BackendOptions &options);
+Backend *CreateTbbBackend(const BackendOptions &options);
+Backend *CreateOpenClBackend(const BackendOptions &options);
+Backend *CreateCudaCpuBackend(const BackendOptions &options);
+Backend *CreateBitplaneBackend(const BackendOptions &options);
+
+// Creates a backend by the name given to --backend= (NULL if unknown or not available)
+Backend *CreateBackend(const std::string &name, const BackendOptions &options);
+// Names accepted by CreateBackend, separated by '|'
+const char *BackendNames();
+// False if the backend was left out of this build (so it is not worth trying)
+bool BackendBuiltIn(const std::string &name);
+// Name of the device the OpenCL backend would use, empty if there is none
+std::string OpenClDeviceName();
+
+#endif
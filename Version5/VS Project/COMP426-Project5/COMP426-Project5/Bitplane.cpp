@@ -0,0 +1,149 @@
+#include "Bitplane.h"
+#include "Stencil.h"
+#include <stdio.h>
+#include <chrono>
+
+void PackBitplanes(const Grid &grid, Bitplanes &planes)
+{
+	/**
+	@Desc : Packs a grid into bitplanes
+	@param1 : area to pack
+	@param2 : receives the bitplanes
+	*/
+
+	planes.width = grid.width;
+	planes.height = grid.height;
+	planes.words = (grid.height + 63) / 64;
+	planes.cancer.assign((size_t)planes.width * planes.words, 0);
+	planes.medicine.assign((size_t)planes.width * planes.words, 0);
+	for (int x = 0; x < grid.width; x++) {
+		for (int y = 0; y < grid.height; y++) {
+			size_t _word = (size_t)x * planes.words + y / 64;
+			BitWord _bit = 1ULL << (y % 64);
+			if (grid.At(x, y) == CANCER)
+				planes.cancer[_word] |= _bit;
+			else if (grid.At(x, y) == MEDICINE)
+				planes.medicine[_word] |= _bit;
+		}
+	}
+}
+
+void UnpackBitplanes(const Bitplanes &planes, Grid &grid)
+{
+	grid.width = planes.width;
+	grid.height = planes.height;
+	grid.cells.resize((size_t)planes.width * planes.height);
+	for (int x = 0; x < planes.width; x++) {
+		for (int y = 0; y < planes.height; y++) {
+			size_t _word = (size_t)x * planes.words + y / 64;
+			int _bit = y % 64;
+			if ((planes.cancer[_word] >> _bit) & 1)
+				grid.At(x, y) = CANCER;
+			else if ((planes.medicine[_word] >> _bit) & 1)
+				grid.At(x, y) = MEDICINE;
+			else
+				grid.At(x, y) = HEALTHY;
+		}
+	}
+}
+
+// Cells y - 1 and y + 1 of every bit of a word: the word shifted by one, with the bit crossing from the next word
+inline BitWord Above(const BitWord *column, int w)
+{
+	return (column[w] << 1) | (w > 0 ? column[w - 1] >> 63 : 0);
+}
+
+inline BitWord Below(const BitWord *column, int w, int words)
+{
+	return (column[w] >> 1) | (w + 1 < words ? column[w + 1] << 63 : 0);
+}
+
+void UpdateBitplanes(const Bitplanes &read, Bitplanes &write, int startX, int endX)
+{
+	/**
+	@Desc : Computes the next generation of a band of columns, 64 cells per word. Medicine only changes through
+	injections and the heal cascade, so only the cancer plane is recomputed
+	@param1 : bitplanes of the current generation
+	@param2 : bitplanes of the next generation
+	@param3 : first column of the band
+	@param4 : one past the last column of the band
+	*/
+
+	const int _words = read.words;
+	// Neighbour columns past the edges of the area are empty
+	std::vector<BitWord> _empty(_words, 0);
+	// Bits past the height, in the last word of each column
+	const BitWord _lastMask = read.height % 64 ? (1ULL << (read.height % 64)) - 1 : ~0ULL;
+	for (int x = startX; x < endX; x++) {
+		const BitWord *_cancer = &read.cancer[(size_t)x * _words];
+		const BitWord *_medicine = &read.medicine[(size_t)x * _words];
+		const BitWord *_cancerLeft = x > 0 ? _cancer - _words : &_empty[0];
+		const BitWord *_cancerRight = x < read.width - 1 ? _cancer + _words : &_empty[0];
+		const BitWord *_medicineLeft = x > 0 ? _medicine - _words : &_empty[0];
+		const BitWord *_medicineRight = x < read.width - 1 ? _medicine + _words : &_empty[0];
+		BitWord *_writeCancer = &write.cancer[(size_t)x * _words];
+		BitWord *_writeMedicine = &write.medicine[(size_t)x * _words];
+
+		for (int w = 0; w < _words; w++) {
+			BitWord _c = _cancer[w];
+			BitWord _m = _medicine[w];
+			BitWord _healthy = ~(_c | _m) & (w == _words - 1 ? _lastMask : ~0ULL);
+
+			BitWord _manyCancer = AtLeastThreshold(Above(_cancerLeft, w), _cancerLeft[w], Below(_cancerLeft, w, _words),
+				Above(_cancer, w), Below(_cancer, w, _words),
+				Above(_cancerRight, w), _cancerRight[w], Below(_cancerRight, w, _words));
+			BitWord _manyMedicine = AtLeastThreshold(Above(_medicineLeft, w), _medicineLeft[w], Below(_medicineLeft, w, _words),
+				Above(_medicine, w), Below(_medicine, w, _words),
+				Above(_medicineRight, w), _medicineRight[w], Below(_medicineRight, w, _words));
+
+			// If a healthy cell is surrounded by >= 6 cancer cells, it becomes a cancer cell.
+			// If a cancer cell is surrounded by >= 6 medicine cells, it becomes a healthy cell
+			_writeCancer[w] = (_c & ~_manyMedicine) | (_healthy & _manyCancer);
+			_writeMedicine[w] = _m;
+		}
+	}
+}
+
+void BenchmarkBitplanes(int width, int height)
+{
+	/**
+	@Desc : Times one core running generations with the generic byte stencil and with the bitplane kernel,
+	and checks the bitplane grid against the stencil's (--bench-swar)
+	@param1 : width of the area
+	@param2 : height of the area
+	*/
+
+	// Enough generations for about 2^30 cell updates
+	double _cellsPerGeneration = (double)width * height;
+	int _generations = (int)(1073741824.0 / _cellsPerGeneration);
+	if (_generations < 3)
+		_generations = 3;
+
+	Grid _grids[2] = { Grid(width, height), Grid(width, height) };
+	InitializeCells(_grids[0], 1);
+	// Some medicine, so the medicine count is exercised too
+	for (int i = 0; i < 64; i++)
+		InjectMedicine(_grids[0], (i * 7919) % width, (i * 104729) % height);
+	Bitplanes _planes[2];
+	PackBitplanes(_grids[0], _planes[0]);
+	_planes[1] = _planes[0];
+
+	std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+	for (int g = 0; g < _generations; g++)
+		UpdateColumnsGeneric(&_grids[g % 2].cells[0], &_grids[1 - g % 2].cells[0], width, height, 0, width);
+	double _scalarSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+
+	_start = std::chrono::steady_clock::now();
+	for (int g = 0; g < _generations; g++)
+		UpdateBitplanes(_planes[g % 2], _planes[1 - g % 2], 0, width);
+	double _swarSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+
+	Grid _result;
+	UnpackBitplanes(_planes[_generations % 2], _result);
+	bool _match = _result.cells == _grids[_generations % 2].cells;
+	printf("generic %dx%d: %8.3f ms/generation, %8.1f Mcells/s per core\n", width, height,
+		_scalarSeconds * 1000.0 / _generations, _cellsPerGeneration * _generations / _scalarSeconds / 1e6);
+	printf("swar    %dx%d: %8.3f ms/generation, %8.1f Mcells/s per core (%.1fx)%s\n", width, height,
+		_swarSeconds * 1000.0 / _generations, _cellsPerGeneration * _generations / _swarSeconds / 1e6,
+		_scalarSeconds / _swarSeconds, _match ? "" : " (MISMATCH)");
+}
@@ -0,0 +1,81 @@
+#ifndef BITPLANE_H
+#define BITPLANE_H
+
+#include <vector>
+#include "Rules.h"
+
+// 64 cells, one bit each
+typedef unsigned long long BitWord;
+
+inline void FullAdd(BitWord a, BitWord b, BitWord c, BitWord &sum, BitWord &carry)
+{
+	BitWord _t = a ^ b;
+	sum = _t ^ c;
+	carry = (a & b) | (_t & c);
+}
+
+inline BitWord AtLeastThreshold(BitWord n0, BitWord n1, BitWord n2, BitWord n3, BitWord n4, BitWord n5, BitWord n6, BitWord n7)
+{
+	/**
+	@Desc : For each of the 64 bit positions, adds the 8 neighbour bits with a network of full adders and tells whether
+	the sum reaches g_surroundThreshold (the "surrounded by >= 6 cells" test of the rule, on 64 cells at once)
+	@param1-8 : neighbour bits (a bit is set if that neighbour is of the counted kind)
+	@return : a bit set where at least g_surroundThreshold neighbours are set
+	*/
+
+	// Bits of weight 1, carries of weight 2
+	BitWord _s0, _c0, _s1, _c1, _s2, _c2;
+	FullAdd(n0, n1, n2, _s0, _c0);
+	FullAdd(n3, n4, n5, _s1, _c1);
+	_s2 = n6 ^ n7;
+	_c2 = n6 & n7;
+	BitWord _bit0, _k1;
+	FullAdd(_s0, _s1, _s2, _bit0, _k1);
+	// Four carries of weight 2 give bit 1 and two carries of weight 4
+	BitWord _t, _u;
+	FullAdd(_c0, _c1, _c2, _t, _u);
+	BitWord _bit1 = _t ^ _k1;
+	BitWord _v = _t & _k1;
+	BitWord _bit2 = _u ^ _v;
+	BitWord _bit3 = _u & _v;
+
+	// Compare the 4-bit sums with the threshold from the top bit down (the threshold is a constant, so this folds)
+	const BitWord _bits[4] = { _bit0, _bit1, _bit2, _bit3 };
+	BitWord _greater = 0;
+	BitWord _equal = ~0ULL;
+	for (int i = 3; i >= 0; i--) {
+		if ((g_surroundThreshold >> i) & 1)
+			_equal &= _bits[i];
+		else
+			_greater |= _equal & _bits[i];
+	}
+	return _greater | _equal;
+}
+
+struct Bitplanes
+{
+	/**
+	@Desc : The area as two bitplanes, is-cancer and is-medicine (a cell with neither bit is healthy).
+	Each column is packed into words of 64 cells along y, so cell (x, y) is bit y % 64 of word
+	x * words + y / 64. Bits past the height stay clear
+	*/
+
+	int width;
+	int height;
+	// Words per column
+	int words;
+	std::vector<BitWord> cancer;
+	std::vector<BitWord> medicine;
+
+	Bitplanes() : width(0), height(0), words(0) { }
+};
+
+// Converts between a grid and its bitplanes
+void PackBitplanes(const Grid &grid, Bitplanes &planes);
+void UnpackBitplanes(const Bitplanes &planes, Grid &grid);
+// Computes the next generation of columns startX to endX - 1
+void UpdateBitplanes(const Bitplanes &read, Bitplanes &write, int startX, int endX);
+// Times the bitplane kernel against the generic stencil on one core (--bench-swar)
+void BenchmarkBitplanes(int width, int height);
+
+#endif
@@ -0,0 +1,73 @@
+#include "Backend.h"
+#include "Bitplane.h"
+#include <stdio.h>
+#include <functional>
+#include <thread>
+#include <vector>
+
+class BitplaneBackend : public Backend
+{
+	/**
+	@Desc : Runs generations on the area packed into bitplanes, 64 cells per word. One thread by default
+	(a generation is short enough that starting threads for it costs more than it saves on small areas),
+	--threads= splits the columns into bands
+	*/
+
+	Bitplanes planes[2];
+	// Index of the bitplanes holding the latest generation
+	int current;
+	int threads;
+
+public:
+	BitplaneBackend(const BackendOptions &options) : current(0), threads(options.threads > 0 ? options.threads : 1) { }
+
+	const char *Name() const { return "swar"; }
+
+	void SetGrid(const Grid &grid)
+	{
+		PackBitplanes(grid, planes[0]);
+		planes[1] = planes[0];
+		current = 0;
+	}
+
+	void Run(int generations)
+	{
+		/**
+		@Desc : Runs generations, swapping the two sets of bitplanes after each one
+		@param1 : number of generations to run
+		*/
+
+		for (int g = 0; g < generations; g++) {
+			const Bitplanes &_read = planes[current];
+			Bitplanes &_write = planes[1 - current];
+			if (threads == 1)
+				UpdateBitplanes(_read, _write, 0, _read.width);
+			else {
+				std::vector<std::thread> _threads;
+				for (int t = 0; t < threads; t++) {
+					int _startX = _read.width * t / threads;
+					int _endX = _read.width * (t + 1) / threads;
+					_threads.push_back(std::thread(UpdateBitplanes, std::cref(_read), std::ref(_write), _startX, _endX));
+				}
+				for (std::size_t t = 0; t < _threads.size(); t++)
+					_threads[t].join();
+			}
+			current = 1 - current;
+		}
+	}
+
+	void GetGrid(Grid &grid)
+	{
+		UnpackBitplanes(planes[current], grid);
+	}
+};
+
+Backend *CreateBitplaneBackend(const BackendOptions &options)
+{
+	// The heal cascade is a flood fill over single cells, it is not ported to bitplanes
+	if (options.cascade) {
+		printf("Error: The swar backend does not run the heal cascade, add --no-cascade!\n");
+		return NULL;
+	}
+	return new BitplaneBackend(options);
+}
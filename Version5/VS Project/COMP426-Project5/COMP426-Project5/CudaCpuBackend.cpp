@@ -0,0 +1,83 @@
+#include "Backend.h"
+#include "UpdateCell.h"
+#include "CpuLauncher.h"
+#include <vector>
+
+class CudaCpuBackend : public Backend
+{
+	/**
+	@Desc : Version 3's strategy: updateKernel's cell rule launched over a grid of blocks (16x32 like Version 3,
+	or tile x tile), run on the CPU by Version 3's launcher. The cells stay in int arrays like the device memory
+	of the CUDA version
+	*/
+
+	BackendOptions options;
+	CpuLauncher launcher;
+	std::vector<int> devRead;
+	std::vector<int> devWrite;
+	int width;
+	int height;
+	// Medicine cells in the area, the cascade is skipped while there are none (see HostBackend)
+	int medicine;
+
+	static void CopyToGrid(const std::vector<int> &cells, Grid &grid)
+	{
+		for (std::size_t i = 0; i < cells.size(); i++)
+			grid.cells[i] = (unsigned char)cells[i];
+	}
+
+public:
+	CudaCpuBackend(const BackendOptions &options) : options(options), launcher(options.threads), width(0), height(0), medicine(0) { }
+
+	const char *Name() const { return "cuda-cpu"; }
+
+	void SetGrid(const Grid &grid)
+	{
+		width = grid.width;
+		height = grid.height;
+		devRead.assign(grid.cells.begin(), grid.cells.end());
+		devWrite = devRead;
+		int _counts[3];
+		CountCells(grid, _counts);
+		medicine = _counts[MEDICINE];
+	}
+
+	void Run(int generations)
+	{
+		/**
+		@Desc : Runs generations the way Version 3's Update does: devWrite starts as a copy of devRead
+		(the kernel only writes changed cells), then the two are swapped
+		@param1 : number of generations to run
+		*/
+
+		Grid _before(width, height);
+		Grid _after(width, height);
+		for (int g = 0; g < generations; g++) {
+			devWrite = devRead;
+			if (options.tile > 0)
+				launcher.Launch(&devRead[0], &devWrite[0], width, height, options.tile, options.tile);
+			else
+				launcher.Launch(&devRead[0], &devWrite[0], width, height, 16, 32);
+			if (options.cascade && medicine > 0) {
+				CopyToGrid(devRead, _before);
+				CopyToGrid(devWrite, _after);
+				medicine -= HealCascade(_before, _after);
+				devWrite.assign(_after.cells.begin(), _after.cells.end());
+			}
+			devRead.swap(devWrite);
+		}
+	}
+
+	void GetGrid(Grid &grid)
+	{
+		grid.width = width;
+		grid.height = height;
+		grid.cells.resize(devRead.size());
+		CopyToGrid(devRead, grid);
+	}
+};
+
+Backend *CreateCudaCpuBackend(const BackendOptions &options)
+{
+	return new CudaCpuBackend(options);
+}
@@ -0,0 +1,124 @@
+#include "Engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+Engine::Engine(Backend *backend, int width, int height)
+	: backend(backend), grid(width, height), gridValid(true), generation(0)
+{
+	backend->SetGrid(grid);
+}
+
+Engine::~Engine()
+{
+	delete backend;
+}
+
+void Engine::Fetch()
+{
+	/**
+	@Desc : Copies the latest generation from the backend if the grid is out of date
+	*/
+
+	if (!gridValid) {
+		backend->GetGrid(grid);
+		gridValid = true;
+	}
+}
+
+void Engine::Reset(unsigned int seed)
+{
+	/**
+	@Desc : Starts again from a new random area
+	@param1 : random seed
+	*/
+
+	InitializeCells(grid, seed);
+	injections.clear();
+	backend->SetGrid(grid);
+	gridValid = true;
+	generation = 0;
+}
+
+void Engine::Inject(int x, int y)
+{
+	/**
+	@Desc : Queues a medicine injection, applied before the next batch of generations
+	@param1 : x position of the cell
+	@param2 : y position of the cell
+	*/
+
+	injections.push_back(x);
+	injections.push_back(y);
+}
+
+void Engine::Run(int generations)
+{
+	/**
+	@Desc : Applies the queued injections, then runs a batch of generations on the backend
+	@param1 : number of generations to run
+	*/
+
+	if (!injections.empty()) {
+		Fetch();
+		for (std::size_t i = 0; i < injections.size(); i += 2)
+			InjectMedicine(grid, injections[i], injections[i + 1]);
+		injections.clear();
+		backend->SetGrid(grid);
+	}
+	backend->Run(generations);
+	gridValid = false;
+	generation += generations;
+}
+
+const Grid &Engine::Cells()
+{
+	/**
+	@Desc : Returns the cells of the latest generation
+	*/
+
+	Fetch();
+	return grid;
+}
+
+void Engine::Counts(int counts[3])
+{
+	/**
+	@Desc : Counts the cells in each state of the latest generation
+	@param1 : receives the number of cells of each state, indexed by state
+	*/
+
+	CountCells(Cells(), counts);
+}
+
+unsigned long long Engine::Checksum()
+{
+	/**
+	@Desc : 64-bit FNV-1a hash of the cells, the same for every backend given the same seed and generations
+	*/
+
+	const Grid &_grid = Cells();
+	unsigned long long _hash = 14695981039346656037ULL;
+	for (std::size_t i = 0; i < _grid.cells.size(); i++) {
+		_hash ^= (unsigned long long)_grid.cells[i];
+		_hash *= 1099511628211ULL;
+	}
+	return _hash;
+}
+
+Engine *CreateEngine(const std::string &backendName, const BackendOptions &options, int width, int height)
+{
+	/**
+	@Desc : Creates the engine for a backend
+	@param1 : name given to --backend=
+	@param2 : settings of the backend
+	@param3 : width of the area
+	@param4 : height of the area
+	*/
+
+	Backend *_backend = CreateBackend(backendName, options);
+	if (!_backend) {
+		printf("Error: Failed to create backend '%s' (one of %s)!\n", backendName.c_str(), BackendNames());
+		exit(1);
+	}
+	return new Engine(_backend, width, height);
+}
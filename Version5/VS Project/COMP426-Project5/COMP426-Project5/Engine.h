@@ -0,0 +1,47 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <string>
+#include <vector>
+#include "Backend.h"
+
+class Engine
+{
+	/**
+	@Desc : The simulation behind a front end: one area, run by the backend chosen at start-up.
+	Injections are queued and applied between batches of generations, and the cells are only
+	fetched from the backend when the front end asks for them
+	*/
+
+	Backend *backend;
+	Grid grid;
+	// The grid holds the backend's latest generation
+	bool gridValid;
+	// Injections (x, y) queued since the last batch
+	std::vector<int> injections;
+	long long generation;
+
+	Engine(const Engine &);
+	Engine &operator=(const Engine &);
+
+	void Fetch();
+
+public:
+	Engine(Backend *backend, int width, int height);
+	~Engine();
+
+	const char *BackendName() const { return backend->Name(); }
+	long long Generation() const { return generation; }
+
+	void Reset(unsigned int seed);
+	void Inject(int x, int y);
+	void Run(int generations);
+	const Grid &Cells();
+	void Counts(int counts[3]);
+	unsigned long long Checksum();
+};
+
+// Creates the engine for the backend named by --backend= (exits if it cannot be created)
+Engine *CreateEngine(const std::string &backendName, const BackendOptions &options, int width, int height);
+
+#endif
@@ -0,0 +1,265 @@
+#include "Ensemble.h"
+#include "Stencil.h"
+#include <stdio.h>
+#include <chrono>
+
+Ensemble::Ensemble(int width, int height) : width(width), height(height), current(0)
+{
+	for (int i = 0; i < 2; i++) {
+		cancer[i].assign((size_t)width * height, 0);
+		medicine[i].assign((size_t)width * height, 0);
+	}
+}
+
+void Ensemble::SetReplica(int replica, const Grid &grid)
+{
+	/**
+	@Desc : Replaces the area of one replica
+	@param1 : replica (0 to 63)
+	@param2 : new area, the same size as the ensemble
+	*/
+
+	BitWord _bit = 1ULL << replica;
+	for (size_t i = 0; i < grid.cells.size(); i++) {
+		cancer[current][i] = (cancer[current][i] & ~_bit) | (grid.cells[i] == CANCER ? _bit : 0);
+		medicine[current][i] = (medicine[current][i] & ~_bit) | (grid.cells[i] == MEDICINE ? _bit : 0);
+	}
+}
+
+void Ensemble::GetReplica(int replica, Grid &grid) const
+{
+	grid.width = width;
+	grid.height = height;
+	grid.cells.resize((size_t)width * height);
+	for (size_t i = 0; i < grid.cells.size(); i++) {
+		if ((cancer[current][i] >> replica) & 1)
+			grid.cells[i] = CANCER;
+		else if ((medicine[current][i] >> replica) & 1)
+			grid.cells[i] = MEDICINE;
+		else
+			grid.cells[i] = HEALTHY;
+	}
+}
+
+void Ensemble::InjectMedicine(int replica, int x, int y)
+{
+	/**
+	@Desc : Injects medicine into a cell of one replica (same rule as InjectMedicine on a grid)
+	@param1 : replica (0 to 63)
+	@param2 : x position of the cell
+	@param3 : y position of the cell
+	*/
+
+	if (x < 0 || x >= width || y < 0 || y >= height)
+		return;
+	BitWord _bit = 1ULL << replica;
+	std::vector<BitWord> &_cancer = cancer[current];
+	std::vector<BitWord> &_medicine = medicine[current];
+	// Absorbed by a cancer cell, which turns healthy
+	if (_cancer[(size_t)x * height + y] & _bit) {
+		_cancer[(size_t)x * height + y] &= ~_bit;
+		return;
+	}
+	// Otherwise the cell and the cells around it become medicine
+	for (int nx = (x > 0 ? x - 1 : 0); nx <= (x < width - 1 ? x + 1 : x); nx++) {
+		for (int ny = (y > 0 ? y - 1 : 0); ny <= (y < height - 1 ? y + 1 : y); ny++) {
+			_cancer[(size_t)nx * height + ny] &= ~_bit;
+			_medicine[(size_t)nx * height + ny] |= _bit;
+		}
+	}
+}
+
+void Ensemble::Run(int generations)
+{
+	/**
+	@Desc : Runs generations of every replica. The neighbours of a cell are whole words, so the rule is the
+	bitplane kernel's without the shifts
+	@param1 : number of generations to run
+	*/
+
+	// Neighbour columns past the edges of the area are empty
+	std::vector<BitWord> _empty(height, 0);
+	for (int g = 0; g < generations; g++) {
+		const BitWord *_readCancer = &cancer[current][0];
+		const BitWord *_readMedicine = &medicine[current][0];
+		BitWord *_writeCancer = &cancer[1 - current][0];
+		BitWord *_writeMedicine = &medicine[1 - current][0];
+		for (int x = 0; x < width; x++) {
+			const BitWord *_c = _readCancer + (size_t)x * height;
+			const BitWord *_m = _readMedicine + (size_t)x * height;
+			const BitWord *_cLeft = x > 0 ? _c - height : &_empty[0];
+			const BitWord *_cRight = x < width - 1 ? _c + height : &_empty[0];
+			const BitWord *_mLeft = x > 0 ? _m - height : &_empty[0];
+			const BitWord *_mRight = x < width - 1 ? _m + height : &_empty[0];
+			for (int y = 0; y < height; y++) {
+				bool _up = y > 0;
+				bool _down = y < height - 1;
+				BitWord _manyCancer = AtLeastThreshold(_up ? _cLeft[y - 1] : 0, _cLeft[y], _down ? _cLeft[y + 1] : 0,
+					_up ? _c[y - 1] : 0, _down ? _c[y + 1] : 0,
+					_up ? _cRight[y - 1] : 0, _cRight[y], _down ? _cRight[y + 1] : 0);
+				BitWord _manyMedicine = AtLeastThreshold(_up ? _mLeft[y - 1] : 0, _mLeft[y], _down ? _mLeft[y + 1] : 0,
+					_up ? _m[y - 1] : 0, _down ? _m[y + 1] : 0,
+					_up ? _mRight[y - 1] : 0, _mRight[y], _down ? _mRight[y + 1] : 0);
+				BitWord _healthy = ~(_c[y] | _m[y]);
+				// If a healthy cell is surrounded by >= 6 cancer cells, it becomes a cancer cell.
+				// If a cancer cell is surrounded by >= 6 medicine cells, it becomes a healthy cell
+				_writeCancer[(size_t)x * height + y] = (_c[y] & ~_manyMedicine) | (_healthy & _manyCancer);
+				_writeMedicine[(size_t)x * height + y] = _m[y];
+			}
+		}
+		current = 1 - current;
+	}
+}
+
+// Bits in the counters below, enough for 2^40 cells
+const int g_counterBits = 40;
+
+inline void AddToCounter(BitWord counter[g_counterBits], BitWord word)
+{
+	/**
+	@Desc : Adds one to the count of every replica whose bit is set, the counts being stored bit-sliced
+	(bit k of counter[i] is bit i of replica k's count). The carry rarely goes past the first few words
+	*/
+
+	for (int i = 0; word && i < g_counterBits; i++) {
+		BitWord _carry = counter[i] & word;
+		counter[i] ^= word;
+		word = _carry;
+	}
+}
+
+void Ensemble::Counts(long long counts[g_replicas][3]) const
+{
+	/**
+	@Desc : Counts the cells in each state of every replica: the bit columns of the words are summed into
+	bit-sliced counters, then each replica's count is read out of its bit column
+	@param1 : receives the number of cells of each state of each replica, indexed by replica then state
+	*/
+
+	BitWord _cancer[g_counterBits] = { 0 };
+	BitWord _medicine[g_counterBits] = { 0 };
+	for (size_t i = 0; i < cancer[current].size(); i++) {
+		AddToCounter(_cancer, cancer[current][i]);
+		AddToCounter(_medicine, medicine[current][i]);
+	}
+	for (int k = 0; k < g_replicas; k++) {
+		long long _numCancer = 0;
+		long long _numMedicine = 0;
+		for (int i = 0; i < g_counterBits; i++) {
+			_numCancer |= (long long)((_cancer[i] >> k) & 1) << i;
+			_numMedicine |= (long long)((_medicine[i] >> k) & 1) << i;
+		}
+		counts[k][CANCER] = _numCancer;
+		counts[k][MEDICINE] = _numMedicine;
+		counts[k][HEALTHY] = (long long)width * height - _numCancer - _numMedicine;
+	}
+}
+
+int RunEnsemble(int width, int height, unsigned int seed, int generations)
+{
+	/**
+	@Desc : Runs 64 replicas with consecutive seeds without a window
+	@param1 : width of the area
+	@param2 : height of the area
+	@param3 : seed of replica 0 (replica k uses seed + k)
+	@param4 : number of generations to run
+	@return : process exit code
+	*/
+
+	Ensemble _ensemble(width, height);
+	Grid _grid(width, height);
+	for (int k = 0; k < g_replicas; k++) {
+		InitializeCells(_grid, seed + k);
+		_ensemble.SetReplica(k, _grid);
+	}
+
+	auto _start = std::chrono::steady_clock::now();
+	_ensemble.Run(generations);
+	double _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+	printf("ensemble: %d generations of %d replicas in %.3f s (%.1f replica generations/s)\n", generations, g_replicas,
+		_seconds, (double)generations * g_replicas / _seconds);
+
+	long long _counts[g_replicas][3];
+	_ensemble.Counts(_counts);
+	for (int k = 0; k < g_replicas; k++) {
+		printf("replica %2d (seed %u): healthy %lld, cancer %lld, medicine %lld\n", k, seed + k,
+			_counts[k][HEALTHY], _counts[k][CANCER], _counts[k][MEDICINE]);
+	}
+	return 0;
+}
+
+void BenchmarkEnsemble(int width, int height)
+{
+	/**
+	@Desc : Runs 64 replicas (each with its own seed and medicine injections) as an ensemble, then one after the
+	other with the generic stencil and with the bitplane kernel, as 64 separate processes would. Every replica
+	and its counts are checked against the generic stencil
+	@param1 : width of the area
+	@param2 : height of the area
+	*/
+
+	// Enough generations for about 2^30 cell updates over all replicas
+	double _cellsPerGeneration = (double)width * height * g_replicas;
+	int _generations = (int)(1073741824.0 / _cellsPerGeneration);
+	if (_generations < 3)
+		_generations = 3;
+
+	std::vector<Grid> _replicas(g_replicas, Grid(width, height));
+	Ensemble _ensemble(width, height);
+	for (int k = 0; k < g_replicas; k++) {
+		InitializeCells(_replicas[k], k + 1);
+		for (int i = 0; i < 16; i++) {
+			int x = (i * 7919 + k * 31) % width;
+			int y = (i * 104729 + k * 17) % height;
+			::InjectMedicine(_replicas[k], x, y);
+		}
+		_ensemble.SetReplica(k, _replicas[k]);
+	}
+
+	auto _start = std::chrono::steady_clock::now();
+	_ensemble.Run(_generations);
+	double _ensembleSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+
+	// The same replicas one at a time, with the bitplane kernel
+	_start = std::chrono::steady_clock::now();
+	for (int k = 0; k < g_replicas; k++) {
+		Bitplanes _planes[2];
+		PackBitplanes(_replicas[k], _planes[0]);
+		_planes[1] = _planes[0];
+		for (int g = 0; g < _generations; g++)
+			UpdateBitplanes(_planes[g % 2], _planes[1 - g % 2], 0, width);
+	}
+	double _swarSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+
+	// And with the generic stencil, which is also the reference
+	_start = std::chrono::steady_clock::now();
+	for (int k = 0; k < g_replicas; k++) {
+		Grid _next(width, height);
+		for (int g = 0; g < _generations; g++) {
+			UpdateColumnsGeneric(&_replicas[k].cells[0], &_next.cells[0], width, height, 0, width);
+			_replicas[k].cells.swap(_next.cells);
+		}
+	}
+	double _genericSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+
+	int _mismatches = 0;
+	long long _counts[g_replicas][3];
+	_ensemble.Counts(_counts);
+	Grid _replica;
+	for (int k = 0; k < g_replicas; k++) {
+		int _expected[3];
+		CountCells(_replicas[k], _expected);
+		_ensemble.GetReplica(k, _replica);
+		if (_replica.cells != _replicas[k].cells || _counts[k][HEALTHY] != _expected[HEALTHY] ||
+			_counts[k][CANCER] != _expected[CANCER] || _counts[k][MEDICINE] != _expected[MEDICINE])
+			_mismatches++;
+	}
+
+	double _replicaGenerations = (double)g_replicas * _generations;
+	printf("%d replicas of %dx%d, %d generations\n", g_replicas, width, height, _generations);
+	printf("generic, one by one: %9.1f replica generations/s\n", _replicaGenerations / _genericSeconds);
+	printf("swar, one by one:    %9.1f replica generations/s (%.1fx)\n", _replicaGenerations / _swarSeconds,
+		_genericSeconds / _swarSeconds);
+	printf("ensemble:            %9.1f replica generations/s (%.1fx)%s\n", _replicaGenerations / _ensembleSeconds,
+		_genericSeconds / _ensembleSeconds, _mismatches ? " (MISMATCH)" : "");
+}
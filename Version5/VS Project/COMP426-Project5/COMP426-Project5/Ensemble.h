@@ -0,0 +1,44 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <vector>
+#include "Bitplane.h"
+
+// Replicas simulated together, one per bit of a word
+const int g_replicas = 64;
+
+class Ensemble
+{
+	/**
+	@Desc : 64 independent areas of the same size run in lock-step. Each cell has an is-cancer and an is-medicine
+	word, and bit k of both belongs to replica k, so one pass of the bitwise rule advances every replica.
+	Words are stored column by column like Grid (cell (x, y) at x * height + y)
+	*/
+
+	int width;
+	int height;
+	std::vector<BitWord> cancer[2];
+	std::vector<BitWord> medicine[2];
+	// Index of the planes holding the latest generation
+	int current;
+
+public:
+	Ensemble(int width, int height);
+
+	int Width() const { return width; }
+	int Height() const { return height; }
+
+	void SetReplica(int replica, const Grid &grid);
+	void GetReplica(int replica, Grid &grid) const;
+	void InjectMedicine(int replica, int x, int y);
+	void Run(int generations);
+	void Counts(long long counts[g_replicas][3]) const;
+};
+
+// Runs 64 replicas seeded seed to seed + 63 without a window, then prints the throughput and the population
+// of each replica (--ensemble=GENERATIONS)
+int RunEnsemble(int width, int height, unsigned int seed, int generations);
+// Times the ensemble against running the 64 replicas one after the other, and checks every replica (--bench-ensemble)
+void BenchmarkEnsemble(int width, int height);
+
+#endif
@@ -0,0 +1,241 @@
+#include "Backend.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef ENGINE_WITH_OPENCL
+#include <string>
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+// Version 4's naive kernel, one work item per cell. The grid size, rule and states come as build options.
+// The range is rounded up to the work-group size, so work items past the last cell do nothing
+const char *EngineKernelSource = "\n\
+__kernel void UpdateCells(__global const uchar* readQuad, __global uchar* writeQuad)\n\
+{\n\
+	int i = get_global_id(0);\n\
+	if (i >= WIDTH * HEIGHT)\n\
+		return;\n\
+	int x = i / HEIGHT;\n\
+	int y = i % HEIGHT;\n\
+	int _state = readQuad[i];\n\
+	if (_state != HEALTHY && _state != CANCER) {\n\
+		writeQuad[i] = _state;\n\
+		return;\n\
+	}\n\
+	// If a healthy cell is surrounded by >= THRESH cancer cells, it becomes a cancer cell.\n\
+	// If a cancer cell is surrounded by >= THRESH medicine cells, it becomes a healthy cell\n\
+	int _before = (_state == HEALTHY) ? CANCER : MEDICINE;\n\
+	int _numSurrounded = 0;\n\
+	for (int nx = max(x - 1, 0); nx <= min(x + 1, WIDTH - 1); nx++) {\n\
+		for (int ny = max(y - 1, 0); ny <= min(y + 1, HEIGHT - 1); ny++) {\n\
+			if ((nx != x || ny != y) && readQuad[nx * HEIGHT + ny] == _before)\n\
+				_numSurrounded++;\n\
+		}\n\
+	}\n\
+	if (_numSurrounded >= THRESH)\n\
+		_state = (_state == HEALTHY) ? CANCER : HEALTHY;\n\
+	writeQuad[i] = _state;\n\
+}\n\
+";
+
+bool SelectDevice(cl_device_id *device)
+{
+	/**
+	@Desc : Finds a GPU on any platform, or the first device of any type if there is none
+	@param1 : receives the selected device
+	@return : false if there is no OpenCL device at all
+	*/
+
+	cl_platform_id _platforms[8];
+	cl_uint _numPlatforms = 0;
+	if (clGetPlatformIDs(8, _platforms, &_numPlatforms) != CL_SUCCESS)
+		return false;
+	if (_numPlatforms > 8)
+		_numPlatforms = 8;
+	bool _found = false;
+	for (cl_uint i = 0; i < _numPlatforms && !_found; i++)
+		_found = clGetDeviceIDs(_platforms[i], CL_DEVICE_TYPE_GPU, 1, device, NULL) == CL_SUCCESS;
+	for (cl_uint i = 0; i < _numPlatforms && !_found; i++)
+		_found = clGetDeviceIDs(_platforms[i], CL_DEVICE_TYPE_ALL, 1, device, NULL) == CL_SUCCESS;
+	return _found;
+}
+
+std::string OpenClDeviceName()
+{
+	cl_device_id _device;
+	char _name[256];
+	if (!SelectDevice(&_device) || clGetDeviceInfo(_device, CL_DEVICE_NAME, sizeof(_name), _name, NULL) != CL_SUCCESS)
+		return "";
+	return _name;
+}
+
+class OpenClBackend : public Backend
+{
+	/**
+	@Desc : Version 4's strategy: the area stays resident in two device buffers that the kernel ping-pongs between,
+	it only crosses the bus on SetGrid and GetGrid
+	*/
+
+	BackendOptions options;
+	cl_device_id device;
+	cl_context context;
+	cl_command_queue queue;
+	cl_program program;
+	cl_kernel kernel;
+	cl_mem quad[2];
+	// Index of the buffer holding the latest generation
+	int current;
+	int width;
+	int height;
+
+	void Release()
+	{
+		/**
+		@Desc : Releases the buffers of the current area
+		*/
+
+		for (int i = 0; i < 2; i++) {
+			if (quad[i])
+				clReleaseMemObject(quad[i]);
+			quad[i] = NULL;
+		}
+		if (kernel)
+			clReleaseKernel(kernel);
+		if (program)
+			clReleaseProgram(program);
+		kernel = NULL;
+		program = NULL;
+	}
+
+public:
+	OpenClBackend(const BackendOptions &options) : options(options), device(NULL), context(NULL), queue(NULL), program(NULL), kernel(NULL), current(0), width(0), height(0)
+	{
+		quad[0] = quad[1] = NULL;
+	}
+
+	~OpenClBackend()
+	{
+		Release();
+		if (queue)
+			clReleaseCommandQueue(queue);
+		if (context)
+			clReleaseContext(context);
+	}
+
+	bool Initialize()
+	{
+		/**
+		@Desc : Finds a device (a GPU if there is one) and creates the context and queue
+		@return : false if there is no usable OpenCL device
+		*/
+
+		if (!SelectDevice(&device))
+			return false;
+
+		cl_int err;
+		context = clCreateContext(0, 1, &device, NULL, NULL, &err);
+		if (!context)
+			return false;
+		queue = clCreateCommandQueue(context, device, 0, &err);
+		return queue != NULL;
+	}
+
+	const char *Name() const { return "opencl"; }
+
+	void SetGrid(const Grid &grid)
+	{
+		/**
+		@Desc : Uploads the area, rebuilding the program when the size changed (it is a build option)
+		@param1 : new area
+		*/
+
+		cl_int err;
+		if (grid.width != width || grid.height != height || !kernel) {
+			Release();
+			width = grid.width;
+			height = grid.height;
+			std::string _options = "-DWIDTH=" + std::to_string(width) + " -DHEIGHT=" + std::to_string(height) +
+				" -DTHRESH=" + std::to_string(g_surroundThreshold) + " -DHEALTHY=" + std::to_string(HEALTHY) +
+				" -DCANCER=" + std::to_string(CANCER) + " -DMEDICINE=" + std::to_string(MEDICINE);
+			program = clCreateProgramWithSource(context, 1, &EngineKernelSource, NULL, &err);
+			if (!program || clBuildProgram(program, 1, &device, _options.c_str(), NULL, NULL) != CL_SUCCESS) {
+				printf("Error: Failed to build the OpenCL engine kernel!\n");
+				exit(1);
+			}
+			kernel = clCreateKernel(program, "UpdateCells", &err);
+			for (int i = 0; i < 2; i++)
+				quad[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, grid.cells.size(), NULL, &err);
+			if (!kernel || !quad[0] || !quad[1]) {
+				printf("Error: Failed to create the OpenCL engine buffers!\n");
+				exit(1);
+			}
+		}
+		current = 0;
+		clEnqueueWriteBuffer(queue, quad[0], CL_TRUE, 0, grid.cells.size(), &grid.cells[0], 0, NULL, NULL);
+	}
+
+	void Run(int generations)
+	{
+		/**
+		@Desc : Enqueues the generations back to back, nothing is read back
+		@param1 : number of generations to run
+		*/
+
+		size_t _local = options.workGroup;
+		size_t _global = (size_t)width * height;
+		if (_local > 0)
+			_global = (_global + _local - 1) / _local * _local;
+		for (int g = 0; g < generations; g++) {
+			clSetKernelArg(kernel, 0, sizeof(cl_mem), &quad[current]);
+			clSetKernelArg(kernel, 1, sizeof(cl_mem), &quad[1 - current]);
+			if (clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &_global, _local > 0 ? &_local : NULL, 0, NULL, NULL) != CL_SUCCESS) {
+				printf("Error: Failed to execute the OpenCL engine kernel!\n");
+				exit(1);
+			}
+			current = 1 - current;
+		}
+		clFlush(queue);
+	}
+
+	void GetGrid(Grid &grid)
+	{
+		grid.width = width;
+		grid.height = height;
+		grid.cells.resize((size_t)width * height);
+		clEnqueueReadBuffer(queue, quad[current], CL_TRUE, 0, grid.cells.size(), &grid.cells[0], 0, NULL, NULL);
+	}
+};
+
+Backend *CreateOpenClBackend(const BackendOptions &options)
+{
+	// The heal cascade is a flood fill that Version 4 only runs with its propagation kernel, not ported here
+	if (options.cascade) {
+		printf("Error: The OpenCL backend does not run the heal cascade, add --no-cascade!\n");
+		return NULL;
+	}
+	OpenClBackend *_backend = new OpenClBackend(options);
+	if (!_backend->Initialize()) {
+		printf("Error: Failed to find an OpenCL device!\n");
+		delete _backend;
+		return NULL;
+	}
+	return _backend;
+}
+
+#else
+
+std::string OpenClDeviceName()
+{
+	return "";
+}
+
+Backend *CreateOpenClBackend(const BackendOptions &)
+{
+	printf("Error: This build has no OpenCL backend (define ENGINE_WITH_OPENCL)!\n");
+	return NULL;
+}
+
+#endif
@@ -0,0 +1,99 @@
+#include "Rules.h"
+#include <stdlib.h>
+
+void InitializeCells(Grid &grid, unsigned int seed)
+{
+	/**
+	@Desc : Fills the area with healthy cells and turns at least 25% of them into cancer cells
+	@param1 : area to fill
+	@param2 : random seed (the same seed gives the same area with every backend)
+	*/
+
+	// Initialize all cells as healthy cells
+	for (std::size_t i = 0; i < grid.cells.size(); i++)
+		grid.cells[i] = HEALTHY;
+
+	// Change at least 25% of cells to cancer cells
+	srand(seed);
+	int _initialCancer = (int)(grid.cells.size() * 0.26);
+	for (int i = 0; i <= _initialCancer; i++) {
+		int x = rand() % grid.width;
+		int y = rand() % grid.height;
+		if (grid.At(x, y) == CANCER)
+			i--;
+		else
+			grid.At(x, y) = CANCER;
+	}
+}
+
+void InjectMedicine(Grid &grid, int x, int y)
+{
+	/**
+	@Desc : Injects medicine into a cell
+	@param1 : area to change
+	@param2 : x position of the cell
+	@param3 : y position of the cell
+	*/
+
+	if (x < 0 || x >= grid.width || y < 0 || y >= grid.height)
+		return;
+	// If medicine is injected on a cancer cell,
+	// the medicine is absorbed and the cell turns into a healthy cell
+	if (grid.At(x, y) == CANCER) {
+		grid.At(x, y) = HEALTHY;
+		return;
+	}
+	// If medicine is injected on a healthy or medicine cell,
+	// the medicine is not absorbed and propagates radially outwards by one cell
+	for (int nx = (x > 0 ? x - 1 : 0); nx <= (x < grid.width - 1 ? x + 1 : x); nx++) {
+		for (int ny = (y > 0 ? y - 1 : 0); ny <= (y < grid.height - 1 ? y + 1 : y); ny++)
+			grid.At(nx, ny) = MEDICINE;
+	}
+}
+
+int HealCascade(const Grid &read, Grid &write)
+{
+	/**
+	@Desc : When a cancer cell turns into a healthy cell, all the surrounding medicine cells also become healthy
+	cells, and so on through the medicine cells around them. Floods from every cancer cell that turned healthy
+	between read and write
+	@param1 : cells before the generation
+	@param2 : cells after the generation (healed cells are changed in place)
+	@return : number of medicine cells that were healed
+	*/
+
+	int _healed = 0;
+	std::vector<int> _stack;
+	for (int i = 0; i < (int)write.cells.size(); i++) {
+		if (read.cells[i] == CANCER && write.cells[i] == HEALTHY)
+			_stack.push_back(i);
+	}
+	while (!_stack.empty()) {
+		int x = _stack.back() / write.height;
+		int y = _stack.back() % write.height;
+		_stack.pop_back();
+		for (int nx = (x > 0 ? x - 1 : 0); nx <= (x < write.width - 1 ? x + 1 : x); nx++) {
+			for (int ny = (y > 0 ? y - 1 : 0); ny <= (y < write.height - 1 ? y + 1 : y); ny++) {
+				if (write.At(nx, ny) == MEDICINE) {
+					write.At(nx, ny) = HEALTHY;
+					_stack.push_back(nx * write.height + ny);
+					_healed++;
+				}
+			}
+		}
+	}
+	return _healed;
+}
+
+void CountCells(const Grid &grid, int counts[3])
+{
+	/**
+	@Desc : Counts the cells in each state
+	@param1 : area to count
+	@param2 : receives the number of cells of each state, indexed by state
+	*/
+
+	counts[HEALTHY] = counts[CANCER] = counts[MEDICINE] = 0;
+	for (std::size_t i = 0; i < grid.cells.size(); i++)
+		counts[grid.cells[i]]++;
+}
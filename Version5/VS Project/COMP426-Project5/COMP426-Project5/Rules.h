@@ -0,0 +1,72 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include <vector>
+
+// Define states for cells
+#define HEALTHY  0
+#define CANCER   1
+#define MEDICINE 2
+
+// A cell changes state when surrounded by at least this many cells of the other kind
+const int g_surroundThreshold = 6;
+
+struct Grid
+{
+	/**
+	@Desc : Cells of the 2D area, one byte per cell, stored column by column (cell (x, y) at x * height + y)
+	*/
+
+	int width;
+	int height;
+	std::vector<unsigned char> cells;
+
+	Grid() : width(0), height(0) { }
+	Grid(int width, int height) : width(width), height(height), cells(width * height, HEALTHY) { }
+
+	unsigned char &At(int x, int y) { return cells[x * height + y]; }
+	unsigned char At(int x, int y) const { return cells[x * height + y]; }
+};
+
+// Static so the stencil units compiled for AVX2 / AVX-512 do not share their copy with the rest of the program
+static inline unsigned char NextState(const unsigned char *read, int x, int y, int width, int height)
+{
+	/**
+	@Desc : Returns the state of a cell in the next generation (the rule every backend runs)
+	@param1 : cells of the current generation
+	@param2 : x position of current cell
+	@param3 : y position of current cell
+	@param4 : width of the area
+	@param5 : height of the area
+	*/
+
+	int _state = read[x * height + y];
+	if (_state != HEALTHY && _state != CANCER)
+		return _state;
+
+	// If a healthy cell is surrounded by >= 6 cancer cells, it becomes a cancer cell.
+	// If a cancer cell is surrounded by >= 6 medicine cells, it becomes a healthy cell
+	int _before = (_state == HEALTHY) ? CANCER : MEDICINE;
+	int _numSurrounded = 0;
+	for (int nx = (x > 0 ? x - 1 : 0); nx <= (x < width - 1 ? x + 1 : x); nx++) {
+		for (int ny = (y > 0 ? y - 1 : 0); ny <= (y < height - 1 ? y + 1 : y); ny++) {
+			if ((nx != x || ny != y) && read[nx * height + ny] == _before)
+				_numSurrounded++;
+		}
+	}
+	if (_numSurrounded >= g_surroundThreshold)
+		return (_state == HEALTHY) ? CANCER : HEALTHY;
+	return _state;
+}
+
+// Fills the area with healthy cells and turns at least 25% of them into cancer cells
+void InitializeCells(Grid &grid, unsigned int seed);
+// Injects medicine into a cell (absorbed by a cancer cell, otherwise spreads to the surrounding cells)
+void InjectMedicine(Grid &grid, int x, int y);
+// Heals the medicine cells connected through medicine to a cancer cell that turned healthy in the last generation,
+// returns how many were healed
+int HealCascade(const Grid &read, Grid &write);
+// Number of cells in each state
+void CountCells(const Grid &grid, int counts[3]);
+
+#endif
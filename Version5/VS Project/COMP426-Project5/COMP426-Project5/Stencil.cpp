@@ -0,0 +1,346 @@
+#include "Stencil.h"
+#include "StencilSimd.h"
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+template <int WIDTH, int HEIGHT, int THRESHOLD>
+void UpdateColumns(const unsigned char *read, unsigned char *write, int width, int height, int startX, int endX)
+{
+	/**
+	@Desc : Computes the next generation of a band of columns. A WIDTH or HEIGHT of 0 takes the size from the
+	arguments, otherwise the size is a compile-time constant and the compiler can fold the column offsets
+	and unroll the inner loop
+	@param1 : cells of the current generation
+	@param2 : cells of the next generation
+	@param3 : width of the area (ignored if WIDTH is given)
+	@param4 : height of the area (ignored if HEIGHT is given)
+	@param5 : first column of the band
+	@param6 : one past the last column of the band
+	*/
+
+	const int _width = WIDTH ? WIDTH : width;
+	const int _height = HEIGHT ? HEIGHT : height;
+	for (int x = startX; x < endX; x++) {
+		unsigned char *_write = write + (size_t)x * _height;
+		// The first and last columns and rows have fewer neighbours, they go through the bounds-checked rule
+		if (x == 0 || x == _width - 1 || _height < 3) {
+			for (int y = 0; y < _height; y++)
+				_write[y] = NextState(read, x, y, _width, _height);
+			continue;
+		}
+		_write[0] = NextState(read, x, 0, _width, _height);
+		_write[_height - 1] = NextState(read, x, _height - 1, _width, _height);
+
+		const unsigned char *_left = read + (size_t)(x - 1) * _height;
+		const unsigned char *_centre = _left + _height;
+		const unsigned char *_right = _centre + _height;
+		for (int y = 1; y < _height - 1; y++) {
+			int _state = _centre[y];
+			if (_state != HEALTHY && _state != CANCER) {
+				_write[y] = (unsigned char)_state;
+				continue;
+			}
+			// If a healthy cell is surrounded by >= THRESHOLD cancer cells, it becomes a cancer cell.
+			// If a cancer cell is surrounded by >= THRESHOLD medicine cells, it becomes a healthy cell
+			int _before = (_state == HEALTHY) ? CANCER : MEDICINE;
+			int _numSurrounded = (_left[y - 1] == _before) + (_left[y] == _before) + (_left[y + 1] == _before) +
+				(_centre[y - 1] == _before) + (_centre[y + 1] == _before) +
+				(_right[y - 1] == _before) + (_right[y] == _before) + (_right[y + 1] == _before);
+			if (_numSurrounded >= THRESHOLD)
+				_state = (_state == HEALTHY) ? CANCER : HEALTHY;
+			_write[y] = (unsigned char)_state;
+		}
+	}
+}
+
+// The sizes worth specialising for (the default window, and the large areas used for benchmarking)
+template void UpdateColumns<1024, 768, g_surroundThreshold>(const unsigned char *, unsigned char *, int, int, int, int);
+template void UpdateColumns<4096, 4096, g_surroundThreshold>(const unsigned char *, unsigned char *, int, int, int, int);
+template void UpdateColumns<16384, 16384, g_surroundThreshold>(const unsigned char *, unsigned char *, int, int, int, int);
+
+struct StencilEntry
+{
+	int width;
+	int height;
+	StencilFunction function;
+};
+
+const StencilEntry g_stencils[] = {
+	{ 1024, 768, UpdateColumns<1024, 768, g_surroundThreshold> },
+	{ 4096, 4096, UpdateColumns<4096, 4096, g_surroundThreshold> },
+	{ 16384, 16384, UpdateColumns<16384, 16384, g_surroundThreshold> },
+};
+
+void UpdateColumnsGeneric(const unsigned char *read, unsigned char *write, int width, int height, int startX, int endX)
+{
+	UpdateColumns<0, 0, g_surroundThreshold>(read, write, width, height, startX, endX);
+}
+
+bool CpuSupports(const std::string &kernel)
+{
+	/**
+	@Desc : Tells whether the CPU (and the operating system, which must save the wider registers) runs a kernel
+	@param1 : sse2, avx2 or avx512
+	*/
+
+	if (kernel == "sse2")
+		return true;
+#ifdef _MSC_VER
+	int _info[4];
+	__cpuid(_info, 0);
+	if (_info[0] < 7)
+		return false;
+	__cpuid(_info, 1);
+	bool _osxsave = (_info[2] & (1 << 27)) != 0;
+	if (!_osxsave)
+		return false;
+	unsigned long long _xcr0 = _xgetbv(0);
+	__cpuidex(_info, 7, 0);
+	if (kernel == "avx2")
+		return (_info[1] & (1 << 5)) && (_xcr0 & 0x6) == 0x6;
+	if (kernel == "avx512")
+		return (_info[1] & (1 << 16)) && (_info[1] & (1 << 30)) && (_xcr0 & 0xE6) == 0xE6;
+#elif defined(__GNUC__)
+	__builtin_cpu_init();
+	if (kernel == "avx2")
+		return __builtin_cpu_supports("avx2");
+	if (kernel == "avx512")
+		return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+	return false;
+}
+
+StencilFunction VectorKernel(const std::string &name)
+{
+	/**
+	@Desc : Returns a vector kernel if both this build and the CPU can run it, otherwise NULL
+	@param1 : sse2, avx2 or avx512
+	*/
+
+	StencilFunction _kernel = NULL;
+	if (name == "sse2")
+		_kernel = StencilSSE2();
+	else if (name == "avx2")
+		_kernel = StencilAVX2();
+	else if (name == "avx512")
+		_kernel = StencilAVX512();
+	return _kernel && CpuSupports(name) ? _kernel : NULL;
+}
+
+StencilFunction ScalarStencil(int width, int height)
+{
+	/**
+	@Desc : Looks the area size up in the table of specialised stencils, the generic stencil if it is not there
+	@param1 : width of the area
+	@param2 : height of the area
+	*/
+
+	for (size_t i = 0; i < sizeof(g_stencils) / sizeof(g_stencils[0]); i++) {
+		if (g_stencils[i].width == width && g_stencils[i].height == height)
+			return g_stencils[i].function;
+	}
+	return UpdateColumnsGeneric;
+}
+
+double SampleSeconds(StencilFunction stencil, int width, int height)
+{
+	/**
+	@Desc : Times a stencil on a sample of an area: the whole area, or for large areas a band of about a million
+	cells of the full height taken from the interior, so the stencil runs its usual path on as much memory as it
+	would see in a generation. Returns the best of a few runs
+	@param1 : stencil to time
+	@param2 : width of the area
+	@param3 : height of the area
+	*/
+
+	// The sample holds the band and the column on either side of it, at the same offsets as in the full area
+	int _band = (int)(1048576 / height) > 64 ? (int)(1048576 / height) : 64;
+	bool _whole = width <= _band + 2;
+	int _columns = _whole ? width : _band + 2;
+	int _startX = _whole ? 0 : 1;
+	int _endX = _whole ? width : _band + 1;
+	Grid _grids[2] = { Grid(_columns, height), Grid(_columns, height) };
+	InitializeCells(_grids[0], 1);
+	_grids[1] = _grids[0];
+
+	// At least a million cells per run, so the runs of small areas are long enough to time
+	int _generations = (int)(1048576.0 / ((double)(_endX - _startX) * height)) + 1;
+	double _best = 0.0;
+	for (int run = 0; run < 3; run++) {
+		std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+		for (int g = 0; g < _generations; g++)
+			stencil(&_grids[g % 2].cells[0], &_grids[1 - g % 2].cells[0], width, height, _startX, _endX);
+		double _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+		if (run == 0 || _seconds < _best)
+			_best = _seconds;
+	}
+	return _best;
+}
+
+// Vector kernel in use, NULL for the scalar stencils
+StencilFunction g_vectorKernel = NULL;
+std::string g_kernelName;
+// Set by --kernel=auto: each area size gets the kernel that was fastest on a sample of it
+bool g_autoKernel = false;
+
+struct AutoChoice
+{
+	int width;
+	int height;
+	StencilFunction function;
+	const char *name;
+};
+
+std::vector<AutoChoice> g_autoChoices;
+
+bool SetStencilKernel(const std::string &name)
+{
+	/**
+	@Desc : Picks the kernel SelectStencil returns
+	@param1 : auto, scalar, sse2, avx2 or avx512
+	*/
+
+	if (name == "auto") {
+		g_autoKernel = true;
+		g_vectorKernel = NULL;
+		g_kernelName = name;
+		return true;
+	}
+	if (name == "scalar") {
+		g_autoKernel = false;
+		g_vectorKernel = NULL;
+		g_kernelName = name;
+		return true;
+	}
+	StencilFunction _kernel = VectorKernel(name);
+	if (!_kernel)
+		return false;
+	g_autoKernel = false;
+	g_vectorKernel = _kernel;
+	g_kernelName = name;
+	return true;
+}
+
+const char *StencilKernelName()
+{
+	if (g_kernelName.empty())
+		SetStencilKernel("auto");
+	return g_kernelName.c_str();
+}
+
+StencilFunction SelectStencil(int width, int height)
+{
+	/**
+	@Desc : Returns the vector kernel in use, or the scalar stencil for the area size. With auto, times the scalar
+	stencil and each vector kernel the CPU runs the first time a size is seen (called from the thread running
+	generations, never from the band threads)
+	@param1 : width of the area
+	@param2 : height of the area
+	*/
+
+	if (g_kernelName.empty())
+		SetStencilKernel("auto");
+	if (!g_autoKernel)
+		return g_vectorKernel ? g_vectorKernel : ScalarStencil(width, height);
+
+	for (size_t i = 0; i < g_autoChoices.size(); i++) {
+		if (g_autoChoices[i].width == width && g_autoChoices[i].height == height) {
+			g_kernelName = g_autoChoices[i].name;
+			return g_autoChoices[i].function;
+		}
+	}
+	// The widest kernel is not always the fastest (AVX-512 can run at a lower clock), so they are ranked by time
+	std::vector<AutoChoice> _candidates;
+	AutoChoice _scalar = { width, height, ScalarStencil(width, height), "scalar" };
+	_candidates.push_back(_scalar);
+	const char *_vectorNames[] = { "sse2", "avx2", "avx512" };
+	for (int i = 0; i < 3; i++) {
+		AutoChoice _vector = { width, height, VectorKernel(_vectorNames[i]), _vectorNames[i] };
+		if (_vector.function)
+			_candidates.push_back(_vector);
+	}
+	// The candidates take turns, so a change of clock speed during the timing does not favour one of them
+	std::vector<double> _seconds(_candidates.size(), 0.0);
+	for (int pass = 0; pass < 3; pass++) {
+		for (size_t i = 0; i < _candidates.size(); i++) {
+			double _pass = SampleSeconds(_candidates[i].function, width, height);
+			if (pass == 0 || _pass < _seconds[i])
+				_seconds[i] = _pass;
+		}
+	}
+	AutoChoice _choice = _candidates[0];
+	double _fastest = _seconds[0];
+	for (size_t i = 1; i < _candidates.size(); i++) {
+		if (_seconds[i] < _fastest) {
+			_fastest = _seconds[i];
+			_choice = _candidates[i];
+		}
+	}
+	g_autoChoices.push_back(_choice);
+	g_kernelName = _choice.name;
+	return _choice.function;
+}
+
+void BenchmarkStencil(int width, int height)
+{
+	/**
+	@Desc : Times one thread running generations with the generic stencil (the reference), the one the dispatch
+	table picks for this size, and each vector kernel this build and CPU can run, checks they all agree, and
+	shows which kernel --kernel=auto picks for this size
+	@param1 : width of the area
+	@param2 : height of the area
+	*/
+
+	std::vector<const char *> _names;
+	std::vector<StencilFunction> _functions;
+	_names.push_back("generic");
+	_functions.push_back(UpdateColumnsGeneric);
+	for (size_t i = 0; i < sizeof(g_stencils) / sizeof(g_stencils[0]); i++) {
+		if (g_stencils[i].width == width && g_stencils[i].height == height) {
+			_names.push_back("specialised");
+			_functions.push_back(g_stencils[i].function);
+		}
+	}
+	if (_functions.size() == 1)
+		printf("No specialised stencil for %dx%d\n", width, height);
+	const char *_vectorNames[] = { "sse2", "avx2", "avx512" };
+	for (int i = 0; i < 3; i++) {
+		StencilFunction _kernel = VectorKernel(_vectorNames[i]);
+		if (_kernel) {
+			_names.push_back(_vectorNames[i]);
+			_functions.push_back(_kernel);
+		}
+		else
+			printf("Skipping %s (not supported by this build or CPU)\n", _vectorNames[i]);
+	}
+
+	// Enough generations for about 2^30 cell updates
+	double _cellsPerGeneration = (double)width * height;
+	int _generations = (int)(1073741824.0 / _cellsPerGeneration);
+	if (_generations < 3)
+		_generations = 3;
+	Grid _reference(width, height);
+	for (size_t run = 0; run < _functions.size(); run++) {
+		Grid _grids[2] = { Grid(width, height), Grid(width, height) };
+		InitializeCells(_grids[0], 1);
+		std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+		for (int g = 0; g < _generations; g++)
+			_functions[run](&_grids[g % 2].cells[0], &_grids[1 - g % 2].cells[0], width, height, 0, width);
+		double _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+		const Grid &_result = _grids[_generations % 2];
+		if (run == 0)
+			_reference = _result;
+		printf("%-11s %dx%d: %8.3f ms/generation, %8.1f Mcells/s%s\n", _names[run], width, height,
+			_seconds * 1000.0 / _generations, _cellsPerGeneration * _generations / _seconds / 1e6,
+			_result.cells == _reference.cells ? "" : " (MISMATCH)");
+	}
+
+	SetStencilKernel("auto");
+	SelectStencil(width, height);
+	printf("auto picks %s for %dx%d\n", StencilKernelName(), width, height);
+}
@@ -0,0 +1,26 @@
+#ifndef STENCIL_H
+#define STENCIL_H
+
+#include <string>
+
+// Computes the next generation of columns startX to endX - 1 (cells stored column by column, as in Grid)
+typedef void (*StencilFunction)(const unsigned char *read, unsigned char *write, int width, int height, int startX, int endX);
+
+// Returns the stencil for an area. The scalar kernel is the one compiled for this area size if there is one
+// (1024x768, 4096x4096, 16384x16384), otherwise the generic stencil that takes the size at runtime; these
+// specialised templates are the scalar path only, the vector kernels always take the size at runtime.
+// With --kernel=auto the scalar and vector kernels are timed on a sample of the area the first time a size
+// is seen, and the fastest is used for that size from then on
+StencilFunction SelectStencil(int width, int height);
+// Picks the kernel by name (--kernel=): auto (the fastest on this CPU, see SelectStencil), scalar, sse2, avx2
+// or avx512. Returns false if the name is unknown or the CPU or compiler cannot run it
+bool SetStencilKernel(const std::string &name);
+// Name of the kernel in use (with auto, the one picked for the last size SelectStencil was asked for)
+const char *StencilKernelName();
+// The stencil that takes the size at runtime (reference for the specialised ones)
+void UpdateColumnsGeneric(const unsigned char *read, unsigned char *write, int width, int height, int startX, int endX);
+
+// Times the specialised stencil against the generic one on an area (--bench-stencil)
+void BenchmarkStencil(int width, int height);
+
+#endif
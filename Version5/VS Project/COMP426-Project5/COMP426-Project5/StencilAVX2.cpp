@@ -0,0 +1,56 @@
+// Compiled for AVX2 (GCC and Clang need the pragma, Visual Studio accepts the intrinsics as they are),
+// only called once CPUID reports AVX2
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC target("avx2")
+#elif defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#endif
+#include "StencilSimd.h"
+#include <immintrin.h>
+
+static int UpdateRowsAVX2(const unsigned char *left, const unsigned char *centre, const unsigned char *right,
+	unsigned char *write, int y0, int y1)
+{
+	/**
+	@Desc : Computes rows 32 at a time (same steps as the SSE2 variant)
+	@return : the first row that was not computed
+	*/
+
+	const __m256i _healthy = _mm256_set1_epi8(HEALTHY);
+	const __m256i _cancer = _mm256_set1_epi8(CANCER);
+	const __m256i _medicine = _mm256_set1_epi8(MEDICINE);
+	const __m256i _threshold = _mm256_set1_epi8(g_surroundThreshold - 1);
+	int y = y0;
+	for (; y + 32 <= y1; y += 32) {
+		const unsigned char *_neighbours[8] = { left + y - 1, left + y, left + y + 1, centre + y - 1, centre + y + 1,
+			right + y - 1, right + y, right + y + 1 };
+		__m256i _numCancer = _mm256_setzero_si256();
+		__m256i _numMedicine = _mm256_setzero_si256();
+		for (int n = 0; n < 8; n++) {
+			__m256i _cells = _mm256_loadu_si256((const __m256i *)_neighbours[n]);
+			_numCancer = _mm256_sub_epi8(_numCancer, _mm256_cmpeq_epi8(_cells, _cancer));
+			_numMedicine = _mm256_sub_epi8(_numMedicine, _mm256_cmpeq_epi8(_cells, _medicine));
+		}
+		__m256i _state = _mm256_loadu_si256((const __m256i *)(centre + y));
+		__m256i _toCancer = _mm256_and_si256(_mm256_cmpeq_epi8(_state, _healthy), _mm256_cmpgt_epi8(_numCancer, _threshold));
+		__m256i _toHealthy = _mm256_and_si256(_mm256_cmpeq_epi8(_state, _cancer), _mm256_cmpgt_epi8(_numMedicine, _threshold));
+		__m256i _next = _mm256_blendv_epi8(_state, _cancer, _toCancer);
+		_next = _mm256_blendv_epi8(_next, _healthy, _toHealthy);
+		_mm256_storeu_si256((__m256i *)(write + y), _next);
+	}
+	return y;
+}
+
+static void UpdateColumnsAVX2(const unsigned char *read, unsigned char *write, int width, int height, int startX, int endX)
+{
+	UpdateColumnsVector(UpdateRowsAVX2, read, write, width, height, startX, endX);
+}
+
+StencilFunction StencilAVX2()
+{
+	return UpdateColumnsAVX2;
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
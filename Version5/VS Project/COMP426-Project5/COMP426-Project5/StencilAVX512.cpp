@@ -0,0 +1,71 @@
+// Compiled for AVX-512BW (byte comparisons into mask registers), only called once CPUID reports it.
+// Visual Studio 2013 has no AVX-512 intrinsics, so the variant is left out there
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC target("avx512f,avx512bw")
+#define STENCIL_AVX512
+#elif defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f,avx512bw"))), apply_to = function)
+#define STENCIL_AVX512
+#elif defined(_MSC_VER) && _MSC_VER >= 1910
+#define STENCIL_AVX512
+#endif
+#include "StencilSimd.h"
+
+#ifdef STENCIL_AVX512
+#include <immintrin.h>
+
+static int UpdateRowsAVX512(const unsigned char *left, const unsigned char *centre, const unsigned char *right,
+	unsigned char *write, int y0, int y1)
+{
+	/**
+	@Desc : Computes rows 64 at a time. The comparisons give masks, which pick the states directly
+	@return : the first row that was not computed
+	*/
+
+	const __m512i _healthy = _mm512_set1_epi8(HEALTHY);
+	const __m512i _cancer = _mm512_set1_epi8(CANCER);
+	const __m512i _medicine = _mm512_set1_epi8(MEDICINE);
+	const __m512i _threshold = _mm512_set1_epi8(g_surroundThreshold - 1);
+	int y = y0;
+	for (; y + 64 <= y1; y += 64) {
+		const unsigned char *_neighbours[8] = { left + y - 1, left + y, left + y + 1, centre + y - 1, centre + y + 1,
+			right + y - 1, right + y, right + y + 1 };
+		__m512i _numCancer = _mm512_setzero_si512();
+		__m512i _numMedicine = _mm512_setzero_si512();
+		for (int n = 0; n < 8; n++) {
+			__m512i _cells = _mm512_loadu_si512((const void *)_neighbours[n]);
+			_numCancer = _mm512_sub_epi8(_numCancer, _mm512_movm_epi8(_mm512_cmpeq_epi8_mask(_cells, _cancer)));
+			_numMedicine = _mm512_sub_epi8(_numMedicine, _mm512_movm_epi8(_mm512_cmpeq_epi8_mask(_cells, _medicine)));
+		}
+		__m512i _state = _mm512_loadu_si512((const void *)(centre + y));
+		__mmask64 _toCancer = _mm512_cmpeq_epi8_mask(_state, _healthy) & _mm512_cmpgt_epi8_mask(_numCancer, _threshold);
+		__mmask64 _toHealthy = _mm512_cmpeq_epi8_mask(_state, _cancer) & _mm512_cmpgt_epi8_mask(_numMedicine, _threshold);
+		__m512i _next = _mm512_mask_mov_epi8(_state, _toCancer, _cancer);
+		_next = _mm512_mask_mov_epi8(_next, _toHealthy, _healthy);
+		_mm512_storeu_si512((void *)(write + y), _next);
+	}
+	return y;
+}
+
+static void UpdateColumnsAVX512(const unsigned char *read, unsigned char *write, int width, int height, int startX, int endX)
+{
+	UpdateColumnsVector(UpdateRowsAVX512, read, write, width, height, startX, endX);
+}
+
+StencilFunction StencilAVX512()
+{
+	return UpdateColumnsAVX512;
+}
+
+#else
+
+StencilFunction StencilAVX512()
+{
+	return NULL;
+}
+
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
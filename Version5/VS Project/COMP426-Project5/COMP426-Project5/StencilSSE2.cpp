@@ -0,0 +1,51 @@
+// SSE2 is the x86-64 baseline, so this variant runs on every host
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC target("sse2")
+#endif
+#include "StencilSimd.h"
+#include <emmintrin.h>
+
+static int UpdateRowsSSE2(const unsigned char *left, const unsigned char *centre, const unsigned char *right,
+	unsigned char *write, int y0, int y1)
+{
+	/**
+	@Desc : Computes rows 16 at a time. A comparison gives -1 in each matching byte, so subtracting it counts neighbours
+	@return : the first row that was not computed
+	*/
+
+	const __m128i _healthy = _mm_set1_epi8(HEALTHY);
+	const __m128i _cancer = _mm_set1_epi8(CANCER);
+	const __m128i _medicine = _mm_set1_epi8(MEDICINE);
+	const __m128i _threshold = _mm_set1_epi8(g_surroundThreshold - 1);
+	int y = y0;
+	for (; y + 16 <= y1; y += 16) {
+		const unsigned char *_neighbours[8] = { left + y - 1, left + y, left + y + 1, centre + y - 1, centre + y + 1,
+			right + y - 1, right + y, right + y + 1 };
+		__m128i _numCancer = _mm_setzero_si128();
+		__m128i _numMedicine = _mm_setzero_si128();
+		for (int n = 0; n < 8; n++) {
+			__m128i _cells = _mm_loadu_si128((const __m128i *)_neighbours[n]);
+			_numCancer = _mm_sub_epi8(_numCancer, _mm_cmpeq_epi8(_cells, _cancer));
+			_numMedicine = _mm_sub_epi8(_numMedicine, _mm_cmpeq_epi8(_cells, _medicine));
+		}
+		__m128i _state = _mm_loadu_si128((const __m128i *)(centre + y));
+		// Healthy cells with >= 6 cancer neighbours become cancer, cancer cells with >= 6 medicine neighbours heal
+		__m128i _toCancer = _mm_and_si128(_mm_cmpeq_epi8(_state, _healthy), _mm_cmpgt_epi8(_numCancer, _threshold));
+		__m128i _toHealthy = _mm_and_si128(_mm_cmpeq_epi8(_state, _cancer), _mm_cmpgt_epi8(_numMedicine, _threshold));
+		__m128i _next = _mm_andnot_si128(_mm_or_si128(_toCancer, _toHealthy), _state);
+		_next = _mm_or_si128(_next, _mm_and_si128(_toCancer, _cancer));
+		_next = _mm_or_si128(_next, _mm_and_si128(_toHealthy, _healthy));
+		_mm_storeu_si128((__m128i *)(write + y), _next);
+	}
+	return y;
+}
+
+static void UpdateColumnsSSE2(const unsigned char *read, unsigned char *write, int width, int height, int startX, int endX)
+{
+	UpdateColumnsVector(UpdateRowsSSE2, read, write, width, height, startX, endX);
+}
+
+StencilFunction StencilSSE2()
+{
+	return UpdateColumnsSSE2;
+}
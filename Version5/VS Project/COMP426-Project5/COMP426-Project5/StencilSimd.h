@@ -0,0 +1,70 @@
+#ifndef STENCIL_SIMD_H
+#define STENCIL_SIMD_H
+
+#include "Stencil.h"
+#include "Rules.h"
+
+// Each instruction set variant lives in its own translation unit, compiled for that instruction set.
+// They return NULL if the compiler cannot build the variant
+StencilFunction StencilSSE2();
+StencilFunction StencilAVX2();
+StencilFunction StencilAVX512();
+
+// The helpers below are static so each translation unit keeps its own copy, compiled for its instruction set
+// (an inline function shared between them could be linked in from the AVX-512 unit and run on any CPU)
+
+// Computes rows y0 to y1 - 1 of an interior column one cell at a time (the rows the vectors do not cover)
+static inline void UpdateRowsScalar(const unsigned char *left, const unsigned char *centre, const unsigned char *right,
+	unsigned char *write, int y0, int y1)
+{
+	for (int y = y0; y < y1; y++) {
+		int _state = centre[y];
+		if (_state != HEALTHY && _state != CANCER) {
+			write[y] = (unsigned char)_state;
+			continue;
+		}
+		int _before = (_state == HEALTHY) ? CANCER : MEDICINE;
+		int _numSurrounded = (left[y - 1] == _before) + (left[y] == _before) + (left[y + 1] == _before) +
+			(centre[y - 1] == _before) + (centre[y + 1] == _before) +
+			(right[y - 1] == _before) + (right[y] == _before) + (right[y + 1] == _before);
+		if (_numSurrounded >= g_surroundThreshold)
+			_state = (_state == HEALTHY) ? CANCER : HEALTHY;
+		write[y] = (unsigned char)_state;
+	}
+}
+
+template <class VectorRows>
+static inline void UpdateColumnsVector(VectorRows rows, const unsigned char *read, unsigned char *write, int width, int height,
+	int startX, int endX)
+{
+	/**
+	@Desc : Computes a band of columns: the edges of the area through NextState, the interior rows through
+	the vector kernel, and the rows it leaves over one cell at a time
+	@param1 : vector kernel, computes rows from y0 in whole vectors and returns the first row it did not compute
+	@param2 : cells of the current generation
+	@param3 : cells of the next generation
+	@param4 : width of the area
+	@param5 : height of the area
+	@param6 : first column of the band
+	@param7 : one past the last column of the band
+	*/
+
+	for (int x = startX; x < endX; x++) {
+		unsigned char *_write = write + (size_t)x * height;
+		if (x == 0 || x == width - 1 || height < 3) {
+			for (int y = 0; y < height; y++)
+				_write[y] = NextState(read, x, y, width, height);
+			continue;
+		}
+		_write[0] = NextState(read, x, 0, width, height);
+		_write[height - 1] = NextState(read, x, height - 1, width, height);
+
+		const unsigned char *_left = read + (size_t)(x - 1) * height;
+		const unsigned char *_centre = _left + height;
+		const unsigned char *_right = _centre + height;
+		int _y = rows(_left, _centre, _right, _write, 1, height - 1);
+		UpdateRowsScalar(_left, _centre, _right, _write, _y, height - 1);
+	}
+}
+
+#endif
@@ -0,0 +1,66 @@
+#include "Backend.h"
+#include <stdio.h>
+
+#ifdef ENGINE_WITH_TBB
+#include "tbb/task_scheduler_init.h"
+#include "tbb/parallel_for.h"
+#include "tbb/blocked_range2d.h"
+
+class DoGeneration
+{
+	/**
+	@Desc : Body of the parallel_for, updates the cells of a 2D blocked range
+	*/
+
+	const Grid *read;
+	Grid *write;
+public:
+	DoGeneration(const Grid *read, Grid *write) : read(read), write(write) { }
+
+	void operator()(const tbb::blocked_range2d<int> &r) const
+	{
+		const unsigned char *_read = &read->cells[0];
+		for (int x = r.cols().begin(); x != r.cols().end(); ++x) {
+			for (int y = r.rows().begin(); y != r.rows().end(); ++y)
+				write->At(x, y) = NextState(_read, x, y, read->width, read->height);
+		}
+	}
+};
+
+class TbbBackend : public HostBackend
+{
+	/**
+	@Desc : Version 2's strategy: a TBB parallel_for over a 2D blocked range of the area
+	*/
+
+	tbb::task_scheduler_init scheduler;
+
+protected:
+	void Generation(const Grid &read, Grid &write)
+	{
+		// Rows (y) first, they are contiguous in memory. A grain of 1 leaves the split to the partitioner
+		int _grain = options.tile > 0 ? options.tile : 1;
+		tbb::parallel_for(tbb::blocked_range2d<int>(0, read.height, _grain, 0, read.width, _grain), DoGeneration(&read, &write));
+	}
+
+public:
+	TbbBackend(const BackendOptions &options)
+		: HostBackend(options), scheduler(options.threads > 0 ? options.threads : tbb::task_scheduler_init::automatic) { }
+
+	const char *Name() const { return "tbb"; }
+};
+
+Backend *CreateTbbBackend(const BackendOptions &options)
+{
+	return new TbbBackend(options);
+}
+
+#else
+
+Backend *CreateTbbBackend(const BackendOptions &)
+{
+	printf("Error: This build has no TBB backend (define ENGINE_WITH_TBB)!\n");
+	return NULL;
+}
+
+#endif
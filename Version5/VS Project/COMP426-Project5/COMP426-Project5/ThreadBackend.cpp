@@ -0,0 +1,51 @@
+#include "Backend.h"
+#include "Stencil.h"
+#include <thread>
+#include <vector>
+
+class ThreadBackend : public HostBackend
+{
+	/**
+	@Desc : Version 1's strategy: the area is split between std::threads, started for every generation
+	and joined before the next one
+	*/
+
+	int threads;
+
+protected:
+	void Generation(const Grid &read, Grid &write)
+	{
+		// Each computation thread updates a band of columns, with the stencil compiled for this size if there is one
+		StencilFunction _stencil = SelectStencil(read.width, read.height);
+		std::vector<std::thread> _threads;
+		for (int t = 0; t < threads; t++) {
+			int _startX = read.width * t / threads;
+			int _endX = read.width * (t + 1) / threads;
+			_threads.push_back(std::thread(_stencil, &read.cells[0], &write.cells[0], read.width, read.height, _startX, _endX));
+		}
+		for (std::size_t t = 0; t < _threads.size(); t++)
+			_threads[t].join();
+	}
+
+public:
+	ThreadBackend(const BackendOptions &options) : HostBackend(options)
+	{
+		threads = options.threads > 0 ? options.threads : (int)std::thread::hardware_concurrency();
+		if (threads < 1)
+			threads = 4;
+	}
+
+	const char *Name() const { return "thread"; }
+
+	void SetGrid(const Grid &grid)
+	{
+		HostBackend::SetGrid(grid);
+		// With --kernel=auto the first call times the kernels, do it now rather than in the first generation
+		SelectStencil(grid.width, grid.height);
+	}
+};
+
+Backend *CreateThreadBackend(const BackendOptions &options)
+{
+	return new ThreadBackend(options);
+}
@@ -0,0 +1,377 @@
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "Engine.h"
+#include "Autotune.h"
+#include "Stencil.h"
+#include "Bitplane.h"
+#include "Ensemble.h"
+
+// OpenGL Graphics includes
+#if defined (__APPLE__) || defined(MACOSX)
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+// 2D area of 1024 x 768 cells unless --size= is given
+int g_windowWidth = 1024;
+int g_windowHeight = 768;
+
+// Update time for 30 FPS (in milliseconds)
+const int g_updateTime = 1.0 / 30.0 * 1000.0;
+
+void *const g_font = GLUT_BITMAP_TIMES_ROMAN_24;
+
+// Colour of each state (healthy green, cancer red, medicine yellow) as RGBA bytes
+const unsigned char g_stateColours[3][4] = { { 0, 128, 0, 255 }, { 255, 0, 0, 255 }, { 255, 255, 0, 255 } };
+
+// The simulation, run by the backend chosen with --backend=
+Engine *g_engine = NULL;
+// Pixels of the cells, rebuilt for every frame
+std::vector<unsigned char> g_image;
+
+void RenderBitmapString(float x, float y, void *font, const char *string)
+{
+	/**
+	@Desc : Renders bitmap strings to display text on screen
+	@param1 : x position of where text should be displayed
+	@param2 : y position of where text should be displayed
+	@param3 : font to be used
+	@param4 : string text to be displayed on screen
+	*/
+
+	const char *c;
+	glRasterPos2f(x, y);
+	for (c = string; *c != '\0'; c++) {
+		glutBitmapCharacter(font, *c);
+	}
+}
+
+int RunHeadless(int generations, int injections)
+{
+	/**
+	@Desc : Runs generations without opening a window, then prints the throughput and a checksum of the grid
+	so the backends (with the same --seed) can be compared
+	@param1 : number of generations to run
+	@param2 : medicine injections before every generation, so the comparison covers injections and the heal cascade.
+	The cells continue the random sequence that Reset started from --seed, so they are the same for every backend
+	@return : process exit code
+	*/
+
+	auto _start = std::chrono::steady_clock::now();
+	if (injections > 0) {
+		for (int g = 0; g < generations; g++) {
+			for (int i = 0; i < injections; i++) {
+				int x = rand() % g_windowWidth;
+				int y = rand() % g_windowHeight;
+				g_engine->Inject(x, y);
+			}
+			g_engine->Run(1);
+		}
+	}
+	else {
+		g_engine->Run(generations);
+	}
+	// The checksum fetches the cells, so the time includes the last generation on asynchronous backends
+	unsigned long long _hash = g_engine->Checksum();
+	double _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+
+	printf("%s: %d generations in %.3f s (%.1f generations/s), grid checksum %016llx\n", g_engine->BackendName(),
+		generations, _seconds, generations / _seconds, _hash);
+	return 0;
+}
+
+void Update(int value)
+{
+	/**
+	@Desc : Runs one generation, and then calls itself (to update again)
+	@param1 : unused parameter that is passed by the glutTimerFunc
+	*/
+
+	g_engine->Run(1);
+	glutPostRedisplay();
+	glutTimerFunc(g_updateTime, Update, 0);
+}
+
+void Display()
+{
+	/**
+	@Desc : Displays the cells and text in a window on screen
+	*/
+
+	const Grid &_grid = g_engine->Cells();
+
+	glClearColor(1, 1, 1, 1);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	gluOrtho2D(0, g_windowWidth, g_windowHeight, 0);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+
+	// The cells are stored by column, the image by row from the top of the window
+	g_image.resize(_grid.cells.size() * 4);
+	for (int x = 0; x < _grid.width; x++) {
+		for (int y = 0; y < _grid.height; y++) {
+			const unsigned char *_colour = g_stateColours[_grid.At(x, y)];
+			unsigned char *_pixel = &g_image[(y * _grid.width + x) * 4];
+			_pixel[0] = _colour[0];
+			_pixel[1] = _colour[1];
+			_pixel[2] = _colour[2];
+			_pixel[3] = _colour[3];
+		}
+	}
+	glRasterPos2f(0, 0);
+	glPixelZoom(1, -1);
+	glDrawPixels(_grid.width, _grid.height, GL_RGBA, GL_UNSIGNED_BYTE, &g_image[0]);
+	glPixelZoom(1, 1);
+
+	int _counts[3];
+	g_engine->Counts(_counts);
+	std::string _hCount = std::to_string(static_cast<long long>(_counts[HEALTHY]));
+	std::string _cCount = std::to_string(static_cast<long long>(_counts[CANCER]));
+	std::string _mCount = std::to_string(static_cast<long long>(_counts[MEDICINE]));
+
+	glColor3f(0, 0, 0);
+	// Display the number of each type of cell and the backend
+	RenderBitmapString(0, 30, g_font, "Healthy: ");
+	RenderBitmapString(0, 50, g_font, _hCount.c_str());
+	RenderBitmapString(0, 100, g_font, "Cancer: ");
+	RenderBitmapString(0, 120, g_font, _cCount.c_str());
+	RenderBitmapString(0, 170, g_font, "Medicine: ");
+	RenderBitmapString(0, 190, g_font, _mCount.c_str());
+	RenderBitmapString(0, 240, g_font, "Backend: ");
+	RenderBitmapString(0, 260, g_font, g_engine->BackendName());
+
+	glutSwapBuffers();
+}
+
+void MouseClicks(int button, int state, int x, int y)
+{
+	/**
+	@Desc : Function that handles mouse buttons being clicked
+	@param1 : mouse button that was clicked
+	@param2 : state of button that was clicked
+	@param3 : x position of pointer when mouse was clicked
+	@param4 : y position of pointer when mouse was clicked
+	*/
+
+	// The medicine is applied before the next generation
+	if (button == GLUT_LEFT_BUTTON && state == GLUT_DOWN)
+		g_engine->Inject(x, y);
+}
+
+void Keyboard(unsigned char key, int mousePositionX, int mousePositionY)
+{
+	/**
+	@Desc : Function that handles keyboard buttons being pressed
+	@param1 : key that was pressed
+	@param2 : x position of mouse pointer
+	@param3 : y position of mouse pointer
+	*/
+
+	switch (key)
+	{
+	// Escape key
+	case 27:
+		delete g_engine;
+		exit ( 0 );
+		break;
+
+	// Start again from a new random area
+	case 'r':
+		g_engine->Reset((unsigned int)time(NULL));
+		glutPostRedisplay();
+		break;
+
+	default:
+		break;
+	}
+}
+
+bool ParseNumber(const std::string &text, unsigned long maximum, unsigned long &value)
+{
+	/**
+	@Desc : Reads a command line value made of decimal digits only
+	@param1 : text of the value
+	@param2 : largest accepted value
+	@param3 : receives the value
+	@return : false if the text is empty, holds anything but digits or is larger than maximum
+	*/
+
+	if (text.empty() || text.size() > 10 || text.find_first_not_of("0123456789") != std::string::npos)
+		return false;
+	unsigned long long _value = strtoull(text.c_str(), NULL, 10);
+	if (_value > maximum)
+		return false;
+	value = (unsigned long)_value;
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	/**
+	@Desc : Main control thread
+	*/
+
+	// Parse the command line options (GLUT ignores the ones it does not know)
+	std::string _backend = "thread";
+	BackendOptions _options;
+	int _headless = 0;
+	int _inject = 0;
+	bool _benchStencil = false;
+	bool _benchSwar = false;
+	bool _benchEnsemble = false;
+	int _ensemble = 0;
+	unsigned int _seed = (unsigned int)time(NULL);
+	bool _autotune = false;
+	bool _retune = false;
+	std::string _tuneCache = DefaultTuneCachePath();
+	double _tuneBudget = 0.5;
+	for (int i = 1; i < argc; i++) {
+		std::string _arg = argv[i];
+		if (_arg.compare(0, 10, "--backend=") == 0)
+			_backend = _arg.substr(10);
+		else if (_arg.compare(0, 10, "--threads=") == 0) {
+			unsigned long _threads;
+			if (!ParseNumber(_arg.substr(10), 1024, _threads)) {
+				printf("Error: --threads= expects a number from 0 (one per core) to 1024!\n");
+				return 1;
+			}
+			_options.threads = (int)_threads;
+		}
+		else if (_arg == "--cascade")
+			_options.cascade = true;
+		else if (_arg == "--no-cascade")
+			_options.cascade = false;
+		else if (_arg.compare(0, 7, "--size=") == 0) {
+			// --size=WIDTHxHEIGHT
+			std::string _size = _arg.substr(7);
+			std::size_t _separator = _size.find('x');
+			unsigned long _width, _height;
+			if (_separator == std::string::npos || !ParseNumber(_size.substr(0, _separator), 16384, _width)
+				|| !ParseNumber(_size.substr(_separator + 1), 16384, _height)) {
+				printf("Error: --size= expects WIDTHxHEIGHT, each up to 16384!\n");
+				return 1;
+			}
+			g_windowWidth = (int)_width;
+			g_windowHeight = (int)_height;
+		}
+		else if (_arg.compare(0, 11, "--headless=") == 0) {
+			unsigned long _generations;
+			if (!ParseNumber(_arg.substr(11), 0x7FFFFFFFUL, _generations)) {
+				printf("Error: --headless= expects a number of generations!\n");
+				return 1;
+			}
+			_headless = (int)_generations;
+		}
+		else if (_arg.compare(0, 9, "--inject=") == 0) {
+			unsigned long _injections;
+			if (!ParseNumber(_arg.substr(9), 1000000, _injections)) {
+				printf("Error: --inject= expects a number of injections per generation up to 1000000!\n");
+				return 1;
+			}
+			_inject = (int)_injections;
+		}
+		else if (_arg.compare(0, 7, "--seed=") == 0) {
+			unsigned long _value;
+			if (!ParseNumber(_arg.substr(7), 0xFFFFFFFFUL, _value)) {
+				printf("Error: --seed= expects a number from 0 to 4294967295!\n");
+				return 1;
+			}
+			_seed = (unsigned int)_value;
+		}
+		else if (_arg.compare(0, 9, "--kernel=") == 0) {
+			if (!SetStencilKernel(_arg.substr(9))) {
+				printf("Error: Stencil kernel %s is unknown or not supported here (auto|scalar|sse2|avx2|avx512)!\n", _arg.substr(9).c_str());
+				return 1;
+			}
+		}
+		else if (_arg == "--bench-stencil")
+			_benchStencil = true;
+		else if (_arg == "--bench-swar")
+			_benchSwar = true;
+		else if (_arg == "--bench-ensemble")
+			_benchEnsemble = true;
+		else if (_arg.compare(0, 11, "--ensemble=") == 0) {
+			unsigned long _generations;
+			if (!ParseNumber(_arg.substr(11), 0x7FFFFFFFUL, _generations)) {
+				printf("Error: --ensemble= expects a number of generations!\n");
+				return 1;
+			}
+			_ensemble = (int)_generations;
+		}
+		else if (_arg == "--autotune")
+			_autotune = true;
+		else if (_arg == "--retune")
+			_autotune = _retune = true;
+		else if (_arg.compare(0, 13, "--tune-cache=") == 0)
+			_tuneCache = _arg.substr(13);
+		else if (_arg.compare(0, 14, "--tune-budget=") == 0) {
+			unsigned long _milliseconds;
+			if (!ParseNumber(_arg.substr(14), 3600000, _milliseconds) || _milliseconds == 0) {
+				printf("Error: --tune-budget= expects a time in ms from 1 to 3600000!\n");
+				return 1;
+			}
+			_tuneBudget = _milliseconds / 1000.0;
+		}
+	}
+	if (g_windowWidth <= 0 || g_windowHeight <= 0) {
+		printf("Error: The area must be at least 1x1!\n");
+		return 1;
+	}
+	if (_benchStencil) {
+		BenchmarkStencil(g_windowWidth, g_windowHeight);
+		return 0;
+	}
+	if (_benchSwar) {
+		BenchmarkBitplanes(g_windowWidth, g_windowHeight);
+		return 0;
+	}
+	if (_benchEnsemble) {
+		BenchmarkEnsemble(g_windowWidth, g_windowHeight);
+		return 0;
+	}
+	// 64 replicas seeded --seed= onwards, run without a window. They are never injected, so the heal cascade
+	// would not change them and --no-cascade is not needed
+	if (_ensemble > 0)
+		return RunEnsemble(g_windowWidth, g_windowHeight, _seed, _ensemble);
+
+	// The autotuner replaces --backend=, --threads= and the tile and work-group sizes with the fastest it finds
+	if (_autotune) {
+		TuneResult _tuned = Autotune(g_windowWidth, g_windowHeight, _options.cascade, argv[0], _tuneCache, _retune, _tuneBudget);
+		_backend = _tuned.backend;
+		_options = _tuned.options;
+	}
+
+	g_engine = CreateEngine(_backend, _options, g_windowWidth, g_windowHeight);
+	g_engine->Reset(_seed);
+
+	// Runs without a window, for benchmarking and for comparing the backends
+	if (_headless > 0) {
+		int _result = RunHeadless(_headless, _inject);
+		delete g_engine;
+		return _result;
+	}
+
+	// initialize
+	glutInit(&argc, argv);
+	glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH );
+	glutInitWindowSize(g_windowWidth, g_windowHeight);
+	glutCreateWindow("2D Cell Growth Simulation");
+
+	glutDisplayFunc(Display);
+	glutMouseFunc(MouseClicks);
+	glutKeyboardFunc(Keyboard);
+	glutTimerFunc(g_updateTime, Update, 0);
+
+	glutMainLoop();
+	return 0;
+}